@@ -27,22 +27,245 @@
 #include "ext_systhread.h"
 #ifdef WIN32
 #include <sys/select.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 #endif
 #include <stdio.h>
-#include <queue>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
 #include <map>
+#include <chrono>
+#include <atomic>
+#include <new>
 
 #define BIT_NFRAMES 20
 #define BIT_MAXFRAMES 120
 #define BIT_MAXCTLFRAMES 10 // for pwm and digi out
+#define BIT_MAXQUEUEFRAMES 1000 // non continuous mode, 1s at 1kHz
 #define BIT_BT_REQUEST_INTERVAL 10
 #define BIT_ASYNC_POLL_INTERVAL 20
 #define BIT_DEF_SYNC_POLL_INTERVAL 2
+#define BIT_SAMPLING_RATE 1000
+#define BIT_SAMPLE_PERIOD 1.          // ms, at BIT_SAMPLING_RATE
+#define BIT_SEQ_MASK 0x0F             // frame sequence numbers are 4 bits
+#define BIT_CLOCK_OFFSET_GAIN 0.01    // clock model : upward offset correction
+#define BIT_CLOCK_RATE_GAIN 0.05      // clock model : sample period correction
+#define BIT_CLOCK_ERROR_GAIN 0.05     // clock model : alignment error smoothing
+#define BIT_GROUP_MAXBOARDS 8
+#define BIT_GROUP_MAXFRAMES 1000      // per board, 1s at BIT_SAMPLING_RATE
+#define BIT_GROUP_MAXOUT BIT_MAXFRAMES // merged frames output per tick
+#define BIT_GROUP_MAXATOMS (1 + 10 * BIT_GROUP_MAXBOARDS)
+#define BIT_NCHANNELS 10              // 6 analog + 4 digital
+#define BIT_SUMMARY_LANES 8           // 6 analog channels, padded for SIMD
+#define BIT_SUMMARY_REF_GAIN (static_cast<double>(BIT_NFRAMES) / BIT_SAMPLING_RATE)
+#define BIT_LATENCY_SUBBINS 4         // latency histograms : bins per octave
+#define BIT_LATENCY_NBINS (32 * BIT_LATENCY_SUBBINS)
+#define BIT_OSC_MAXBUNDLE 15          // frames per datagram (fits a 1500 MTU)
+#define BIT_OSC_DEFBUNDLE 10
+#define BIT_OSC_FRAMESIZE 96          // bundle element holding one frame
+#define BIT_OSC_MAXDATAGRAM (16 + BIT_OSC_MAXBUNDLE * BIT_OSC_FRAMESIZE)
+#define BIT_OSC_NTP_UNIX_OFFSET 2208988800. // seconds from 1900 to 1970
+
+#ifdef WIN32
+typedef SOCKET t_bitalino_socket;
+#define BIT_INVALID_SOCKET INVALID_SOCKET
+#define bitalino_closesocket closesocket
+#else
+typedef int t_bitalino_socket;
+#define BIT_INVALID_SOCKET -1
+#define bitalino_closesocket close
+#endif
 
 // Global vars prevent other objects to interfere with devices currently in use.
 // First object to start on a specific port gets the exclusive connection
 // until it releases it.
 std::map<std::string, bool> busy_bitalinos;
+t_systhread_mutex busy_bitalinos_mutex;
+
+// Fixed capacity FIFO used on the acquisition and output paths, so that
+// nothing is allocated once the object is created. When full, push() drops
+// the oldest element and returns false.
+template <typename T, int N>
+class bitalino_ring {
+public:
+  bitalino_ring() : head(0), count(0) {}
+  
+  bool empty() const { return count == 0; }
+  int size() const { return count; }
+  int capacity() const { return N; }
+  
+  T &front() { return items[head]; }
+  T &back() { return items[(head + count - 1) % N]; }
+  T &operator[](int i) { return items[(head + i) % N]; }
+  
+  bool push(const T &item) {
+    bool room = count < N;
+    if (!room) pop();
+    items[(head + count) % N] = item;
+    count++;
+    return room;
+  }
+  
+  void pop() {
+    head = (head + 1) % N;
+    count--;
+  }
+  
+  void clear() { head = count = 0; }
+  
+private:
+  T items[N];
+  int head;
+  int count;
+};
+
+struct _bitalino;
+
+// A frame placed on the common (host monotonic clock) timeline, in ms.
+typedef struct _bitalino_stamped_frame {
+  double              time;
+  BITalino::Frame     frame;
+} t_bitalino_stamped_frame;
+
+// Maps the sample counter of a board onto the host clock :
+// time(n) = anchor_time + (n - anchor_sample) * period.
+// Reads complete some (variable) time after the samples were taken, so the
+// model follows the lower envelope of the read times, and the sample period
+// is slowly adapted to compensate for the board's crystal drift.
+typedef struct _bitalino_clock_model {
+  bool                valid;
+  unsigned char       last_seq;
+  unsigned long long  nsamples;         // samples since connection
+  unsigned long long  anchor_sample;
+  double              anchor_time;
+  unsigned long long  first_sample;
+  double              first_time;
+  double              period;           // estimated sample period (ms)
+  double              error;            // smoothed residual (ms)
+  unsigned long       lost;             // missing sequence numbers
+} t_bitalino_clock_model;
+
+typedef struct _bitalino_group t_bitalino_group;
+
+typedef struct _bitalino_group_member {
+  struct _bitalino                        *owner;
+  t_bitalino_group                        *group;
+  bitalino_ring<t_bitalino_stamped_frame,
+                BIT_GROUP_MAXFRAMES>      frames;
+  double                                  error;
+  bool                                    streaming; // connected and reading
+} t_bitalino_group_member;
+
+// Boards sharing a sync group feed their stamped frames to the group.
+// The first streaming member (the leader) resamples all streaming members
+// to shared timestamps and outputs the merged frames.
+struct _bitalino_group {
+  t_symbol                                *name;
+  std::vector<t_bitalino_group_member *>  members;
+  double                                  origin;   // timeline zero (ms)
+  double                                  cursor;   // next merged timestamp
+  int                                     pins;     // outputs in progress
+  t_atom                                  merged[BIT_GROUP_MAXOUT]
+                                                [BIT_GROUP_MAXATOMS];
+};
+
+std::map<t_symbol *, t_bitalino_group *> bitalino_groups;
+t_systhread_mutex bitalino_groups_mutex;
+
+enum {
+  BIT_LATENCY_READ_QUEUE = 0,   // read completion -> copy into frame_buffer
+  BIT_LATENCY_QUEUE_OUTPUT,     // copy into frame_buffer -> outlet
+  BIT_LATENCY_COMMAND_WIRE,     // command message -> sent to the device
+  BIT_LATENCY_NSTAGES
+};
+
+// Log-scale histogram of latencies in microseconds, BIT_LATENCY_SUBBINS bins
+// per octave. Written lock-free from any thread.
+typedef struct _bitalino_histogram {
+  std::atomic<unsigned int> bins[BIT_LATENCY_NBINS];
+  std::atomic<unsigned int> max;
+} t_bitalino_histogram;
+
+typedef struct _bitalino_queued_frame {
+  BITalino::Frame     frame;
+  double              time;   // when queued, 0 if not probed (or already)
+} t_bitalino_queued_frame;
+
+typedef struct _bitalino_pwm_command {
+  int                 value;
+  double              time;
+} t_bitalino_pwm_command;
+
+typedef struct _bitalino_trigger_command {
+  bool                value[4];
+  double              time;
+} t_bitalino_trigger_command;
+
+// Per channel statistics of the frames received since last output, stored
+// as arrays of BIT_SUMMARY_LANES so that the reduction loops vectorise.
+typedef struct _bitalino_summary {
+  double              min[BIT_SUMMARY_LANES];
+  double              max[BIT_SUMMARY_LANES];
+  double              sum[BIT_SUMMARY_LANES];
+  double              sumsq[BIT_SUMMARY_LANES];
+  double              crossings[BIT_SUMMARY_LANES];
+  long                count;
+} t_bitalino_summary;
+
+// Zero crossings are counted around a running mean of each channel (time
+// constant of about 1s), carried from block to block with the last sample
+// of the previous block so that crossings between blocks are counted too.
+typedef struct _bitalino_summary_ref {
+  double              mean[BIT_SUMMARY_LANES];
+  double              last[BIT_SUMMARY_LANES];
+  bool                valid;
+} t_bitalino_summary_ref;
+
+// Destination resolved by the @host and @port setters on the main thread
+// and handed to the acquisition thread.
+typedef struct _bitalino_net_address {
+  bool                valid;
+  struct sockaddr_storage addr;
+  socklen_t           addrlen;
+} t_bitalino_net_address;
+
+// OSC over UDP sender, only used by the acquisition thread.
+// Each datagram is a bundle holding one bundle per frame, whose time tag
+// is the frame's time on the clock model timeline.
+typedef struct _bitalino_net {
+  t_bitalino_socket   sock;
+  t_bitalino_net_address address;       // what sock was opened for
+  double              clock_offset;     // system clock - steady clock (ms)
+  char                buffer[BIT_OSC_MAXDATAGRAM];
+  long                size;             // bytes used in buffer
+  long                nframes;          // frames in buffer
+  double              first_time;       // when the first frame was added
+  std::atomic<unsigned long> sent;
+  std::atomic<unsigned long> errors;
+} t_bitalino_net;
+
+// Written by the acquisition thread, read by the stats method.
+typedef struct _bitalino_stats {
+  std::atomic<unsigned long> frames;        // read from the device
+  std::atomic<unsigned long> lost;          // missing sequence numbers
+  std::atomic<unsigned long> overflows;     // dropped from full buffers
+  std::atomic<unsigned long> read_errors;
+  std::atomic<unsigned long long> cpu_us;   // acquisition thread CPU time
+  unsigned long       last_frames;          // at previous stats output
+  unsigned long long  last_cpu_us;
+  double              last_time;
+} t_bitalino_stats;
+
+t_symbol *bitalino_sym_group;
+t_symbol *bitalino_sym_group_error;
+t_symbol *bitalino_sym_battery;
+t_symbol *bitalino_sym_battery_threshold;
 
 /**
  * @todo add a method to control buffer queues sizes
@@ -54,40 +277,79 @@ typedef struct _bitalino {
   t_systhread         systhread;        // thread reference
   t_systhread_mutex   mutex;            // mutual exclusion lock for threadsafety
   t_systhread_mutex   qmutex;           // only used by queue
-  int                 systhread_cancel;	// thread cancel flag
+  t_systhread_mutex   cmutex;           // only used by command queues
+  std::atomic<bool>   systhread_cancel;	// thread cancel flag
+  std::atomic<bool>   running;          // false once the thread has ended
   void                *qelem;           // for message passing between threads
   int                 sleeptime;
   
-  unsigned char       automatic;
+  std::atomic<unsigned char> automatic;
   unsigned char       continuous;
   
-  bool                query_state;
-  bool                got_state;
+  std::atomic<bool>   query_state;
+  std::atomic<bool>   got_state;
   BITalino::State     state;
   
-  std::queue<std::vector<bool>> digiout_buffer;
-  std::queue<int>               pwmout_buffer;
-  int                           bat_threshold;
+  bitalino_ring<t_bitalino_trigger_command, BIT_MAXCTLFRAMES> digiout_buffer;
+  bitalino_ring<t_bitalino_pwm_command, BIT_MAXCTLFRAMES>     pwmout_buffer;
+  std::atomic<int>              bat_threshold;
+  std::atomic<double>           bat_time;
+  std::atomic<double>           state_time;
   
   BITalino::VFrame    *frames;
   //BITalino::VFrame    *local_frames;
   //BITalino::VFrame    *frame_buffer;
-  std::queue<BITalino::Frame> *frame_buffer;
+  bitalino_ring<t_bitalino_queued_frame, BIT_MAXQUEUEFRAMES> *frame_buffer;
   //bool                new_frame;
   //bool                first_frame;
   unsigned char       frame_zero_id;
   
-  const char          *analog_messages_out[6];
-  const char          *digital_messages_out[4];
+  t_symbol            *analog_messages_out[6];
+  t_symbol            *digital_messages_out[2][4];  // v1, v2
+  t_symbol            *analog_state_messages_out[6];
+  t_symbol            *digital_state_messages_out[4];
   void                *m_poll;
   double              poll_interval;
   void                *p_outlet;
   
-  bool                connected;
-  int                 bitalino_version;
+  std::atomic<bool>   connected;
+  std::atomic<int>    bitalino_version;   // set by bitalino_get for "unknown"
   int                 bitalino_id;
   std::string         bitalino_mac;
   std::string         bitalino_portname;  // can be "ab-cd" (with numbers) or "anonymous"
+  std::string         busy_portname;      // port reserved by bitalino_start
+  
+  t_symbol                *group;
+  t_bitalino_group_member *group_member;
+  t_bitalino_clock_model  clock_model;
+  t_bitalino_stamped_frame stamped_frames[BIT_NFRAMES];
+  
+  std::atomic<unsigned char> probes;
+  double                  read_time;
+  t_bitalino_histogram    latency[BIT_LATENCY_NSTAGES];
+  
+  // change driven output, channels are A1-A6 then the 4 digital ones
+  unsigned char           onchange[BIT_NCHANNELS];
+  double                  deadband[6];
+  double                  keepalive;        // max silence (ms), 0 = none
+  bool                    has_output[BIT_NCHANNELS];
+  double                  last_output[BIT_NCHANNELS];
+  double                  last_output_time[BIT_NCHANNELS];
+  
+  std::atomic<unsigned char> summary;
+  t_bitalino_summary      summary_acc;      // protected by qmutex
+  t_bitalino_summary_ref  summary_ref;      // only used by bitalino_qfn
+  t_symbol                *summary_messages_out[6];
+  
+  t_symbol                *net_host;
+  long                    net_port;         // 0 = no network output
+  std::atomic<long>       net_bundle;       // frames per datagram
+  std::atomic<double>     net_interval;     // max frame wait (ms)
+  t_bitalino_net_address  net_address;      // protected by mutex
+  bool                    net_changed;      // protected by mutex
+  t_bitalino_net          net;
+  
+  t_bitalino_stats        stats;
 } t_bitalino;
 
 void bitalino_find(t_bitalino *x);
@@ -100,7 +362,42 @@ void bitalino_trigger(t_bitalino *x, t_symbol *s, long argc, t_atom *argv);
 void bitalino_connect(t_bitalino *x, t_symbol *s, long argc, t_atom *argv);
 void bitalino_disconnect(t_bitalino *x);
 
+double bitalino_now(void);
+void bitalino_clock_reset(t_bitalino_clock_model *m);
+void bitalino_clock_update(t_bitalino_clock_model *m, BITalino::VFrame &frames,
+                           double now, t_bitalino_stamped_frame *stamped);
+void bitalino_group_join(t_bitalino *x, t_symbol *name);
+void bitalino_group_leave(t_bitalino *x);
+void bitalino_group_push(t_bitalino *x);
+void bitalino_group_stop(t_bitalino *x);
+void bitalino_group_output(t_bitalino *x);
+void bitalino_probe(t_bitalino *x, int stage, double since);
+void bitalino_histogram_reset(t_bitalino_histogram *h);
+void bitalino_histogram_add(t_bitalino_histogram *h, unsigned int us);
+double bitalino_histogram_percentile(t_bitalino_histogram *h, double p);
+void bitalino_latency(t_bitalino *x, t_symbol *s, long argc, t_atom *argv);
+
 void bitalino_bang(t_bitalino *x);
+void bitalino_output_frame(t_bitalino *x, const BITalino::Frame &f);
+bool bitalino_output_changed(t_bitalino *x, int channel, double value,
+                             double now);
+void bitalino_output_reset(t_bitalino *x);
+void bitalino_summary_reset(t_bitalino_summary *acc);
+void bitalino_summary_block(t_bitalino_summary *block,
+                            t_bitalino_summary_ref *ref,
+                            BITalino::VFrame &frames);
+void bitalino_summary_merge(t_bitalino_summary *acc,
+                            const t_bitalino_summary *block);
+void bitalino_output_summary(t_bitalino *x);
+void bitalino_net_resolve(t_bitalino *x);
+void bitalino_net_update(t_bitalino *x);
+void bitalino_net_close(t_bitalino *x);
+void bitalino_net_push(t_bitalino *x);
+void bitalino_net_flush(t_bitalino *x);
+bool bitalino_port_acquire(const std::string &port);
+void bitalino_port_release(const std::string &port);
+void bitalino_stats(t_bitalino *x, t_symbol *s, long argc, t_atom *argv);
+void bitalino_stats_reset(t_bitalino *x);
 void *bitalino_get(t_bitalino *x);  // threaded function
 void bitalino_qfn(t_bitalino *x);   // function writing frames to thread-safe local frames
 void bitalino_clock(t_bitalino *x);
@@ -117,6 +414,32 @@ t_max_err bitalino_get_automatic(t_bitalino *x, t_object *attr,
                                  long *argc, t_atom **argv);
 t_max_err bitalino_set_automatic(t_bitalino *x, t_object *attr,
                                  long argc, t_atom *argv);
+t_max_err bitalino_set_group(t_bitalino *x, t_object *attr,
+                             long argc, t_atom *argv);
+t_max_err bitalino_get_probes(t_bitalino *x, t_object *attr,
+                              long *argc, t_atom **argv);
+t_max_err bitalino_set_probes(t_bitalino *x, t_object *attr,
+                              long argc, t_atom *argv);
+t_max_err bitalino_set_onchange(t_bitalino *x, t_object *attr,
+                                long argc, t_atom *argv);
+t_max_err bitalino_set_deadband(t_bitalino *x, t_object *attr,
+                                long argc, t_atom *argv);
+t_max_err bitalino_get_summary(t_bitalino *x, t_object *attr,
+                               long *argc, t_atom **argv);
+t_max_err bitalino_set_summary(t_bitalino *x, t_object *attr,
+                               long argc, t_atom *argv);
+t_max_err bitalino_set_host(t_bitalino *x, t_object *attr,
+                            long argc, t_atom *argv);
+t_max_err bitalino_set_port(t_bitalino *x, t_object *attr,
+                            long argc, t_atom *argv);
+t_max_err bitalino_get_bundle(t_bitalino *x, t_object *attr,
+                              long *argc, t_atom **argv);
+t_max_err bitalino_set_bundle(t_bitalino *x, t_object *attr,
+                              long argc, t_atom *argv);
+t_max_err bitalino_get_sendinterval(t_bitalino *x, t_object *attr,
+                                    long *argc, t_atom **argv);
+t_max_err bitalino_set_sendinterval(t_bitalino *x, t_object *attr,
+                                    long argc, t_atom *argv);
 
 t_class *bitalino_class;
 
@@ -142,6 +465,8 @@ int C74_EXPORT main(void)
   class_addmethod(c, (method)bitalino_battery,    "battery",    A_LONG,   0);
   class_addmethod(c, (method)bitalino_pwm,        "pwm",        A_LONG,   0);
   class_addmethod(c, (method)bitalino_trigger,    "trigger",    A_GIMME,  0);
+  class_addmethod(c, (method)bitalino_latency,    "latency",    A_GIMME,  0);
+  class_addmethod(c, (method)bitalino_stats,      "stats",      A_GIMME,  0);
   //class_addmethod(c, (method)bitalino_anything,   "anything",   A_GIMME,  0);
   
   CLASS_ATTR_CHAR       (c, "automatic",    0, t_bitalino, automatic);
@@ -157,9 +482,74 @@ int C74_EXPORT main(void)
   
   CLASS_ATTR_DOUBLE     (c, "interval",   0, t_bitalino, poll_interval);
   
+  CLASS_ATTR_SYM        (c, "group",      0, t_bitalino, group);
+  CLASS_ATTR_LABEL      (c, "group",      0, "sync group name");
+  CLASS_ATTR_ACCESSORS  (c, "group", NULL, bitalino_set_group);
+  
+  CLASS_ATTR_CHAR       (c, "probes",     0, t_bitalino, probes);
+  CLASS_ATTR_STYLE_LABEL(c, "probes",     0, "onoff",
+                         "latency measurements (see latency message)");
+  CLASS_ATTR_ACCESSORS  (c, "probes", bitalino_get_probes, bitalino_set_probes);
+  
+  CLASS_ATTR_CHAR_ARRAY (c, "onchange",   0, t_bitalino, onchange,
+                         BIT_NCHANNELS);
+  CLASS_ATTR_LABEL      (c, "onchange",   0,
+                         "output A1-A6 I1-I4 channels only when they change");
+  CLASS_ATTR_ACCESSORS  (c, "onchange", NULL, bitalino_set_onchange);
+  
+  CLASS_ATTR_DOUBLE_ARRAY(c, "deadband",  0, t_bitalino, deadband, 6);
+  CLASS_ATTR_LABEL      (c, "deadband",   0,
+                         "A1-A6 changes ignored in onchange mode");
+  CLASS_ATTR_ACCESSORS  (c, "deadband", NULL, bitalino_set_deadband);
+  
+  CLASS_ATTR_CHAR       (c, "summary",    0, t_bitalino, summary);
+  CLASS_ATTR_STYLE_LABEL(c, "summary",    0, "onoff",
+                         "output per channel statistics instead of frames");
+  CLASS_ATTR_ACCESSORS  (c, "summary", bitalino_get_summary, bitalino_set_summary);
+  
+  CLASS_ATTR_SYM        (c, "host",       0, t_bitalino, net_host);
+  CLASS_ATTR_LABEL      (c, "host",       0, "OSC over UDP destination host");
+  CLASS_ATTR_ACCESSORS  (c, "host", NULL, bitalino_set_host);
+  
+  CLASS_ATTR_LONG       (c, "port",       0, t_bitalino, net_port);
+  CLASS_ATTR_LABEL      (c, "port",       0,
+                         "OSC over UDP destination port (0 = off)");
+  CLASS_ATTR_FILTER_CLIP(c, "port",       0, 65535);
+  CLASS_ATTR_ACCESSORS  (c, "port", NULL, bitalino_set_port);
+  
+  CLASS_ATTR_LONG       (c, "bundle",     0, t_bitalino, net_bundle);
+  CLASS_ATTR_LABEL      (c, "bundle",     0, "frames per OSC datagram");
+  CLASS_ATTR_FILTER_CLIP(c, "bundle",     1, BIT_OSC_MAXBUNDLE);
+  CLASS_ATTR_ACCESSORS  (c, "bundle", bitalino_get_bundle, bitalino_set_bundle);
+  
+  CLASS_ATTR_DOUBLE     (c, "sendinterval", 0, t_bitalino, net_interval);
+  CLASS_ATTR_LABEL      (c, "sendinterval", 0,
+                         "max delay before sending an incomplete bundle (ms)");
+  CLASS_ATTR_FILTER_MIN (c, "sendinterval", 0);
+  CLASS_ATTR_ACCESSORS  (c, "sendinterval", bitalino_get_sendinterval,
+                         bitalino_set_sendinterval);
+  
+  CLASS_ATTR_DOUBLE     (c, "keepalive",  0, t_bitalino, keepalive);
+  CLASS_ATTR_LABEL      (c, "keepalive",  0,
+                         "max silence of onchange channels (ms, 0 = none)");
+  CLASS_ATTR_FILTER_MIN (c, "keepalive",  0);
+  
   class_register(CLASS_BOX, c);
   bitalino_class = c;
   
+  systhread_mutex_new(&bitalino_groups_mutex, 0);
+  systhread_mutex_new(&busy_bitalinos_mutex, 0);
+  
+#ifdef WIN32
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+  
+  bitalino_sym_group = gensym("/group");
+  bitalino_sym_group_error = gensym("/group/error");
+  bitalino_sym_battery = gensym("/state/battery");
+  bitalino_sym_battery_threshold = gensym("/state/battery_threshold");
+  
   post("bitalino object loaded");
   return 0;
 }
@@ -172,17 +562,47 @@ void *bitalino_new(t_symbol *s, long argc, t_atom *argv)
   t_bitalino *x;
   
   x = (t_bitalino *)object_alloc(bitalino_class);
-  x->analog_messages_out[0] = "/A1";
-  x->analog_messages_out[1] = "/A2";
-  x->analog_messages_out[2] = "/A3";
-  x->analog_messages_out[3] = "/A4";
-  x->analog_messages_out[4] = "/A5";
-  x->analog_messages_out[5] = "/A6";
-  
-  x->digital_messages_out[0] = "/I1";
-  x->digital_messages_out[1] = "/I2";
-  x->digital_messages_out[2] = "/XX"; // depends on BITalino version (set in 'get')
-  x->digital_messages_out[3] = "/XX"; // depends on BITalino version
+  
+  // object_alloc doesn't run constructors
+  new (&x->bitalino_mac) std::string();
+  new (&x->bitalino_portname) std::string();
+  new (&x->busy_portname) std::string();
+  
+  x->analog_messages_out[0] = gensym("/A1");
+  x->analog_messages_out[1] = gensym("/A2");
+  x->analog_messages_out[2] = gensym("/A3");
+  x->analog_messages_out[3] = gensym("/A4");
+  x->analog_messages_out[4] = gensym("/A5");
+  x->analog_messages_out[5] = gensym("/A6");
+  
+  x->digital_messages_out[0][0] = gensym("/I1");
+  x->digital_messages_out[0][1] = gensym("/I2");
+  x->digital_messages_out[0][2] = gensym("/I3");
+  x->digital_messages_out[0][3] = gensym("/I4");
+  
+  x->digital_messages_out[1][0] = gensym("/I1");
+  x->digital_messages_out[1][1] = gensym("/I2");
+  x->digital_messages_out[1][2] = gensym("/O1");
+  x->digital_messages_out[1][3] = gensym("/O2");
+  
+  x->analog_state_messages_out[0] = gensym("/state/A1");
+  x->analog_state_messages_out[1] = gensym("/state/A2");
+  x->analog_state_messages_out[2] = gensym("/state/A3");
+  x->analog_state_messages_out[3] = gensym("/state/A4");
+  x->analog_state_messages_out[4] = gensym("/state/A5");
+  x->analog_state_messages_out[5] = gensym("/state/A6");
+  
+  x->digital_state_messages_out[0] = gensym("/state/I1");
+  x->digital_state_messages_out[1] = gensym("/state/I2");
+  x->digital_state_messages_out[2] = gensym("/state/O1"); // only v2 has state
+  x->digital_state_messages_out[3] = gensym("/state/O2");
+  
+  x->summary_messages_out[0] = gensym("/summary/A1");
+  x->summary_messages_out[1] = gensym("/summary/A2");
+  x->summary_messages_out[2] = gensym("/summary/A3");
+  x->summary_messages_out[3] = gensym("/summary/A4");
+  x->summary_messages_out[4] = gensym("/summary/A5");
+  x->summary_messages_out[5] = gensym("/summary/A6");
   
   x->p_outlet = outlet_new(x, NULL);
   
@@ -190,6 +610,9 @@ void *bitalino_new(t_symbol *s, long argc, t_atom *argv)
   x->systhread = NULL;
   systhread_mutex_new(&x->mutex,0);
   systhread_mutex_new(&x->qmutex,0);
+  systhread_mutex_new(&x->cmutex,0);
+  x->systhread_cancel = false;
+  x->running = false;
   
   x->sleeptime = BIT_BT_REQUEST_INTERVAL;
   x->frames = new BITalino::VFrame(BIT_NFRAMES);
@@ -197,7 +620,8 @@ void *bitalino_new(t_symbol *s, long argc, t_atom *argv)
   x->m_poll = clock_new((t_object *)x, (method)bitalino_clock);
   //x->local_frames = new BITalino::VFrame(BIT_NFRAMES);
   
-  x->frame_buffer = new std::queue<BITalino::Frame>();//new BITalino::VFrame(100);
+  x->frame_buffer = new bitalino_ring<t_bitalino_queued_frame,
+                                      BIT_MAXQUEUEFRAMES>();
   x->frame_zero_id = 0;
   //x->new_frame = false;
   
@@ -212,7 +636,48 @@ void *bitalino_new(t_symbol *s, long argc, t_atom *argv)
   x->query_state = false;
   x->got_state = false;
   
+  x->digiout_buffer.clear();
+  x->pwmout_buffer.clear();
   x->bat_threshold = -1;
+  x->bat_time = 0;
+  x->state_time = 0;
+  
+  x->group = gensym("");
+  x->group_member = NULL;
+  bitalino_clock_reset(&x->clock_model);
+  x->clock_model.period = BIT_SAMPLE_PERIOD;
+  
+  x->probes = 0;
+  x->read_time = 0;
+  for (int i = 0; i < BIT_LATENCY_NSTAGES; i++) {
+    bitalino_histogram_reset(x->latency + i);
+  }
+  
+  for (int i = 0; i < BIT_NCHANNELS; i++) {
+    x->onchange[i] = 0;
+  }
+  for (int i = 0; i < 6; i++) {
+    x->deadband[i] = 0;
+  }
+  x->keepalive = 0;
+  bitalino_output_reset(x);
+  
+  x->summary = 0;
+  bitalino_summary_reset(&x->summary_acc);
+  x->summary_ref.valid = false;
+  
+  x->net_host = gensym("");
+  x->net_port = 0;
+  x->net_bundle = BIT_OSC_DEFBUNDLE;
+  x->net_interval = 0;
+  x->net_address.valid = false;
+  x->net_changed = false;
+  x->net.sock = BIT_INVALID_SOCKET;
+  x->net.address.valid = false;
+  x->net.sent = 0;
+  x->net.errors = 0;
+  
+  bitalino_stats_reset(x);
   
   attr_args_process(x, argc, argv);
   
@@ -223,17 +688,26 @@ void bitalino_free(t_bitalino *x)
 {
   // stop thread
   bitalino_stop(x);
+  bitalino_group_leave(x);
   
   if (x->qelem)
     qelem_free(x->qelem);
   
-  // free out mutex
+  // free out mutexes
   if (x->mutex)
     systhread_mutex_free(x->mutex);
+  if (x->qmutex)
+    systhread_mutex_free(x->qmutex);
+  if (x->cmutex)
+    systhread_mutex_free(x->cmutex);
   
   object_free(x->m_poll);
   delete(x->frames);
   delete(x->frame_buffer);
+  
+  x->bitalino_mac.~basic_string();
+  x->bitalino_portname.~basic_string();
+  x->busy_portname.~basic_string();
 }
 
 //------------------------------------------------------------------------------
@@ -241,12 +715,13 @@ void bitalino_free(t_bitalino *x)
 void bitalino_assist(t_bitalino *x, void *b, long m, long a, char *s)
 {
   if (m == ASSIST_OUTLET) {
-    sprintf(s,"OSC-style BITalino channels messages");
+    sprintf(s,"OSC-style BITalino channels messages (and /group merged frames)");
   } else {
     switch (a) {
       case 0:
         sprintf(s,"connect [mac-suffix], disconnect, getstate, battery [0;63], \
-                   pwm [0;255], trigger <0/1 0/1 [0/1 0/1]>");
+                   pwm [0;255], trigger <0/1 0/1 [0/1 0/1]>, latency [reset], \
+                   stats [reset]");
         break;
     }
   }
@@ -263,6 +738,7 @@ void bitalino_getstate(t_bitalino *x) {
   if(x->bitalino_version < 2) {
     post("sorry, BITalino v1 doesn't support the state command");
   } else {
+    x->state_time = x->probes ? bitalino_now() : 0;
     x->query_state = true;
   }
 }
@@ -274,6 +750,7 @@ void bitalino_battery(t_bitalino *x, long n) {
   }
   
   int val = n > 63 ? 63 : (n < 0 ? 0 : n);
+  x->bat_time = x->probes ? bitalino_now() : 0;
   x->bat_threshold = val;
 }
 
@@ -283,49 +760,837 @@ void bitalino_pwm(t_bitalino *x, long n) {
     return;
   }
   
-  if(x->bitalino_version < 2) {
-    post("sorry, BITalino v1 doesn't support the pwm command");
-    return;
+  if(x->bitalino_version < 2) {
+    post("sorry, BITalino v1 doesn't support the pwm command");
+    return;
+  } else {
+    t_bitalino_pwm_command cmd;
+    cmd.value = n > 255 ? 255 : (n < 0 ? 0 : n);
+    cmd.time = x->probes ? bitalino_now() : 0;
+    systhread_mutex_lock(x->cmutex);
+    if (!x->pwmout_buffer.push(cmd)) {  // drops the oldest command when full
+      x->stats.overflows++;
+    }
+    systhread_mutex_unlock(x->cmutex);
+  }
+}
+
+void bitalino_trigger(t_bitalino *x, t_symbol *s, long argc, t_atom *argv) {
+  if (!x->connected) {
+    post("no BITalino connected");
+    return;
+  }
+  
+  // v1 has 4 digital outputs, v2 has 2
+  t_bitalino_trigger_command cmd;
+  int tot = fmin(argc, x->bitalino_version < 2 ? 4 : 2);
+  for (int i = 0; i < 4; i++) {
+    cmd.value[i] = i < tot ? atom_getlong(argv + i) > 0 : false;
+  }
+  cmd.time = x->probes ? bitalino_now() : 0;
+  systhread_mutex_lock(x->cmutex);
+  if (!x->digiout_buffer.push(cmd)) {  // drops the oldest command when full
+    x->stats.overflows++;
+  }
+  systhread_mutex_unlock(x->cmutex);
+}
+
+//============================= group sync ===================================//
+
+double bitalino_now(void)
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keeps the current period estimate (only reset on connection)
+void bitalino_clock_reset(t_bitalino_clock_model *m)
+{
+  m->valid = false;
+  m->last_seq = 0;
+  m->nsamples = 0;
+  m->anchor_sample = 0;
+  m->anchor_time = 0;
+  m->first_sample = 0;
+  m->first_time = 0;
+  m->error = 0;
+  m->lost = 0;
+}
+
+// called from the acquisition thread right after each read
+void bitalino_clock_update(t_bitalino_clock_model *m, BITalino::VFrame &frames,
+                           double now, t_bitalino_stamped_frame *stamped)
+{
+  unsigned long long n[BIT_NFRAMES];
+  
+  // count samples from sequence numbers, so that dropped frames keep
+  // their place on the timeline
+  for (int i = 0; i < BIT_NFRAMES; i++) {
+    unsigned char seq = frames[i].seq & BIT_SEQ_MASK;
+    if (m->valid || i > 0) {
+      unsigned char delta = (seq - m->last_seq) & BIT_SEQ_MASK;
+      unsigned int step = (delta == 0) ? BIT_SEQ_MASK + 1 : delta;
+      m->nsamples += step;
+      m->lost += step - 1;
+    }
+    m->last_seq = seq;
+    n[i] = m->nsamples;
+  }
+  
+  unsigned long long last = n[BIT_NFRAMES - 1];
+  
+  if (!m->valid) {
+    m->anchor_sample = m->first_sample = last;
+    m->anchor_time = m->first_time = now;
+    m->valid = true;
+  } else {
+    double predicted = m->anchor_time +
+                       (last - m->anchor_sample) * m->period;
+    double residual = now - predicted;
+    
+    // the last sample of a block can't arrive before it was taken :
+    // follow early reads at once, late ones slowly
+    double anchor = predicted + (residual < 0 ? residual :
+                                 residual * BIT_CLOCK_OFFSET_GAIN);
+    
+    // but the timeline keeps increasing : the block starts at least a tenth
+    // of a period after the last sample of the previous one (after a late
+    // first read, the offset is corrected over a few blocks)
+    double earliest = m->anchor_time + (last - n[0] + 0.1) * m->period;
+    m->anchor_time = anchor > earliest ? anchor : earliest;
+    m->anchor_sample = last;
+    m->error += (fabs(residual) - m->error) * BIT_CLOCK_ERROR_GAIN;
+    
+    // the period is measured between two points of the lower envelope :
+    // during the first second the reference follows the anchor, so that a
+    // late first read doesn't bias the rate
+    if (last - m->first_sample > BIT_SAMPLING_RATE) {
+      double period = (m->anchor_time - m->first_time) /
+                      (last - m->first_sample);
+      m->period += (period - m->period) * BIT_CLOCK_RATE_GAIN;
+    } else {
+      m->first_time = m->anchor_time - (last - m->first_sample) * m->period;
+    }
+  }
+  
+  for (int i = 0; i < BIT_NFRAMES; i++) {
+    stamped[i].time = m->anchor_time -
+                      (m->anchor_sample - n[i]) * m->period;
+    stamped[i].frame = frames[i];
+  }
+}
+
+void bitalino_group_join(t_bitalino *x, t_symbol *name)
+{
+  systhread_mutex_lock(bitalino_groups_mutex);
+  
+  t_bitalino_group *g;
+  std::map<t_symbol *, t_bitalino_group *>::iterator it;
+  it = bitalino_groups.find(name);
+  
+  if (it == bitalino_groups.end()) {
+    g = new t_bitalino_group();
+    g->name = name;
+    g->origin = bitalino_now();
+    g->cursor = -1;
+    g->pins = 0;
+    bitalino_groups[name] = g;
+  } else {
+    g = it->second;
+  }
+  
+  if (g->members.size() >= BIT_GROUP_MAXBOARDS) {
+    systhread_mutex_unlock(bitalino_groups_mutex);
+    object_error((t_object *)x, "BITalino : group %s is full (%d boards)",
+                 name->s_name, BIT_GROUP_MAXBOARDS);
+    return;
+  }
+  
+  t_bitalino_group_member *m = new t_bitalino_group_member();
+  m->owner = x;
+  m->group = g;
+  m->error = 0;
+  m->streaming = false;
+  g->members.push_back(m);
+  x->group_member = m;
+  
+  systhread_mutex_unlock(bitalino_groups_mutex);
+}
+
+void bitalino_group_leave(t_bitalino *x)
+{
+  systhread_mutex_lock(bitalino_groups_mutex);
+  
+  t_bitalino_group_member *m = x->group_member;
+  
+  if (m != NULL) {
+    t_bitalino_group *g = m->group;
+    
+    for (size_t i = 0; i < g->members.size(); i++) {
+      if (g->members[i] == m) {
+        g->members.erase(g->members.begin() + i);
+        break;
+      }
+    }
+    
+    // a group being output is deleted by bitalino_group_output
+    if (g->members.empty()) {
+      bitalino_groups.erase(g->name);
+      if (g->pins == 0) {
+        delete g;
+      }
+    }
+    
+    delete m;
+    x->group_member = NULL;
+  }
+  
+  systhread_mutex_unlock(bitalino_groups_mutex);
+}
+
+// called from the acquisition thread, after bitalino_clock_update
+void bitalino_group_push(t_bitalino *x)
+{
+  systhread_mutex_lock(bitalino_groups_mutex);
+  
+  t_bitalino_group_member *m = x->group_member;
+  
+  if (m != NULL && x->clock_model.valid) {
+    for (int i = 0; i < BIT_NFRAMES; i++) {
+      if (!m->frames.push(x->stamped_frames[i])) {  // drops the oldest
+        x->stats.overflows++;
+      }
+    }
+    m->error = x->clock_model.error;
+    m->streaming = true;
+  }
+  
+  systhread_mutex_unlock(bitalino_groups_mutex);
+}
+
+// called from the acquisition thread when it ends or stops reading, so that
+// stale frames don't hold back the rest of the group
+void bitalino_group_stop(t_bitalino *x)
+{
+  systhread_mutex_lock(bitalino_groups_mutex);
+  
+  t_bitalino_group_member *m = x->group_member;
+  
+  if (m != NULL) {
+    m->frames.clear();
+    m->streaming = false;
+  }
+  
+  systhread_mutex_unlock(bitalino_groups_mutex);
+}
+
+// Output merged frames for all timestamps covered by every streaming board
+// of the group, analog values are linearly interpolated, digital ones are
+// held. Members that are not streaming output zeros, and -1 as their error.
+// Only the group leader outputs anything.
+void bitalino_group_output(t_bitalino *x)
+{
+  t_atom errors[BIT_GROUP_MAXBOARDS];
+  long nmembers = 0;
+  long nmerged = 0;
+  void *outlet = x->p_outlet;
+  
+  systhread_mutex_lock(bitalino_groups_mutex);
+  
+  t_bitalino_group_member *self = x->group_member;
+  t_bitalino_group_member *leader = NULL;
+  
+  if (self != NULL) {
+    for (size_t i = 0; i < self->group->members.size(); i++) {
+      if (self->group->members[i]->streaming) {
+        leader = self->group->members[i];
+        break;
+      }
+    }
+  }
+  
+  // a downstream object can't trigger another output of the same group
+  if (leader == NULL || leader != self || self->group->pins > 0) {
+    systhread_mutex_unlock(bitalino_groups_mutex);
+    return;
+  }
+  
+  t_bitalino_group *g = self->group;
+  nmembers = g->members.size();
+  
+  double start = 0;
+  double end = 0;
+  bool ready = true;
+  bool first = true;
+  
+  for (long i = 0; i < nmembers; i++) {
+    t_bitalino_group_member *m = g->members[i];
+    atom_setfloat(errors + i, m->streaming ? m->error : -1);
+    
+    if (!m->streaming) continue;
+    
+    if (m->frames.empty()) {
+      ready = false;
+      continue;
+    }
+    if (first || m->frames.front().time > start) {
+      start = m->frames.front().time;
+    }
+    if (first || m->frames.back().time < end) {
+      end = m->frames.back().time;
+    }
+    first = false;
+  }
+  
+  if (ready) {
+    if (g->cursor < start) {
+      g->cursor = start;
+    }
+    
+    while (g->cursor <= end && nmerged < BIT_GROUP_MAXOUT) {
+      t_atom *a = g->merged[nmerged];
+      atom_setfloat(a++, g->cursor - g->origin);
+      
+      for (long i = 0; i < nmembers; i++) {
+        bitalino_ring<t_bitalino_stamped_frame, BIT_GROUP_MAXFRAMES> &frames =
+          g->members[i]->frames;
+        
+        if (!g->members[i]->streaming) {
+          for (int j = 0; j < 10; j++) {
+            atom_setlong(a++, 0);
+          }
+          continue;
+        }
+        
+        while (frames.size() > 1 && frames[1].time <= g->cursor) {
+          frames.pop();
+        }
+        
+        const t_bitalino_stamped_frame &f0 = frames[0];
+        const t_bitalino_stamped_frame &f1 = frames.size() > 1 ? frames[1]
+                                                               : frames[0];
+        double span = f1.time - f0.time;
+        double w = span > 0 ? (g->cursor - f0.time) / span : 0;
+        
+        for (int j = 0; j < 6; j++) {
+          atom_setfloat(a++, f0.frame.analog[j] +
+                        w * (f1.frame.analog[j] - f0.frame.analog[j]));
+        }
+        for (int j = 0; j < 4; j++) {
+          atom_setlong(a++, f0.frame.digital[j] ? 1 : 0);
+        }
+      }
+      
+      nmerged++;
+      g->cursor += BIT_SAMPLE_PERIOD;
+    }
+  }
+  
+  // pinned : downstream objects may leave the group while it is output
+  g->pins++;
+  systhread_mutex_unlock(bitalino_groups_mutex);
+  
+  // output outside of the lock so that downstream objects can talk back to
+  // any member of the group
+  for (long i = 0; i < nmerged; i++) {
+    outlet_anything(outlet, bitalino_sym_group, 1 + 10 * nmembers,
+                    g->merged[i]);
+  }
+  if (nmerged > 0) {
+    outlet_anything(outlet, bitalino_sym_group_error, nmembers, errors);
+  }
+  
+  systhread_mutex_lock(bitalino_groups_mutex);
+  g->pins--;
+  if (g->members.empty() && g->pins == 0) {
+    delete g;
+  }
+  systhread_mutex_unlock(bitalino_groups_mutex);
+}
+
+//============================ latency probes ================================//
+
+// `since` is the probe start time, 0 when the probes were disabled then.
+void bitalino_probe(t_bitalino *x, int stage, double since)
+{
+  if (!x->probes || since <= 0) return;
+  
+  double us = (bitalino_now() - since) * 1000.;
+  if (us < 0) us = 0;
+  if (us > UINT_MAX) us = UINT_MAX;
+  bitalino_histogram_add(x->latency + stage, static_cast<unsigned int>(us));
+}
+
+void bitalino_histogram_reset(t_bitalino_histogram *h)
+{
+  for (int i = 0; i < BIT_LATENCY_NBINS; i++) {
+    h->bins[i].store(0, std::memory_order_relaxed);
+  }
+  h->max.store(0, std::memory_order_relaxed);
+}
+
+// bins [0;BIT_LATENCY_SUBBINS[ are exact, each following octave is split
+// into BIT_LATENCY_SUBBINS bins
+static int bitalino_histogram_bin(unsigned int us)
+{
+  if (us < BIT_LATENCY_SUBBINS) return us;
+  
+  int msb = 0;
+  while ((us >> msb) > 1) msb++;
+  
+  int sub = (us >> (msb - 2)) & (BIT_LATENCY_SUBBINS - 1);
+  return (msb - 1) * BIT_LATENCY_SUBBINS + sub;
+}
+
+static double bitalino_histogram_bin_max(int bin)
+{
+  if (bin < BIT_LATENCY_SUBBINS) return bin;
+  
+  int msb = bin / BIT_LATENCY_SUBBINS + 1;
+  int sub = bin % BIT_LATENCY_SUBBINS;
+  return ldexp(BIT_LATENCY_SUBBINS + sub + 1, msb - 2) - 1;
+}
+
+void bitalino_histogram_add(t_bitalino_histogram *h, unsigned int us)
+{
+  h->bins[bitalino_histogram_bin(us)].fetch_add(1, std::memory_order_relaxed);
+  
+  unsigned int max = h->max.load(std::memory_order_relaxed);
+  while (us > max &&
+         !h->max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    // max is reloaded by compare_exchange_weak
+  }
+}
+
+// in ms, upper bound of the bin containing the p-th percentile
+double bitalino_histogram_percentile(t_bitalino_histogram *h, double p)
+{
+  unsigned int counts[BIT_LATENCY_NBINS];
+  unsigned long long total = 0;
+  
+  for (int i = 0; i < BIT_LATENCY_NBINS; i++) {
+    counts[i] = h->bins[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  
+  if (total == 0) return 0;
+  
+  unsigned long long rank = static_cast<unsigned long long>(ceil(p * total));
+  unsigned long long sum = 0;
+  
+  for (int i = 0; i < BIT_LATENCY_NBINS; i++) {
+    sum += counts[i];
+    if (sum >= rank) {
+      double us = bitalino_histogram_bin_max(i);
+      double max = h->max.load(std::memory_order_relaxed);
+      return (us < max ? us : max) * 0.001;
+    }
+  }
+  
+  return h->max.load(std::memory_order_relaxed) * 0.001;
+}
+
+void bitalino_latency(t_bitalino *x, t_symbol *s, long argc, t_atom *argv)
+{
+  const char *stages[BIT_LATENCY_NSTAGES] = {
+    "/latency/read_queue",
+    "/latency/queue_output",
+    "/latency/command_wire"
+  };
+  
+  if (argc > 0 && atom_getsym(argv) == gensym("reset")) {
+    for (int i = 0; i < BIT_LATENCY_NSTAGES; i++) {
+      bitalino_histogram_reset(x->latency + i);
+    }
+    return;
+  }
+  
+  if (!x->probes) {
+    post("BITalino : latency probes are disabled (see @probes)");
+  }
+  
+  for (int i = 0; i < BIT_LATENCY_NSTAGES; i++) {
+    t_bitalino_histogram *h = x->latency + i;
+    t_atom values_out[4];
+    atom_setfloat(values_out, bitalino_histogram_percentile(h, 0.5));
+    atom_setfloat(values_out + 1, bitalino_histogram_percentile(h, 0.95));
+    atom_setfloat(values_out + 2, bitalino_histogram_percentile(h, 0.99));
+    atom_setfloat(values_out + 3,
+                  h->max.load(std::memory_order_relaxed) * 0.001);
+    outlet_anything(x->p_outlet, gensym(stages[i]), 4, values_out);
+  }
+}
+
+//============================= summary mode =================================//
+
+void bitalino_summary_reset(t_bitalino_summary *acc)
+{
+  for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+    acc->min[l] = 0;
+    acc->max[l] = 0;
+    acc->sum[l] = 0;
+    acc->sumsq[l] = 0;
+    acc->crossings[l] = 0;
+  }
+  acc->count = 0;
+}
+
+// Reduce a block of BIT_NFRAMES frames. Frames are first transposed so that
+// every following loop runs over all channels at once (the inner loops have
+// a fixed BIT_SUMMARY_LANES trip count and no branches, and are vectorised
+// by the compiler).
+void bitalino_summary_block(t_bitalino_summary *block,
+                            t_bitalino_summary_ref *ref,
+                            BITalino::VFrame &frames)
+{
+  // v[0] is the last sample of the previous block
+  double v[BIT_NFRAMES + 1][BIT_SUMMARY_LANES];
+  
+  for (int i = 0; i < BIT_NFRAMES; i++) {
+    for (int l = 0; l < 6; l++) {
+      v[i + 1][l] = frames[i].analog[l];
+    }
+    for (int l = 6; l < BIT_SUMMARY_LANES; l++) {
+      v[i + 1][l] = 0;
+    }
+  }
+  
+  double *mn = block->min;
+  double *mx = block->max;
+  double *sum = block->sum;
+  double *sumsq = block->sumsq;
+  double *zc = block->crossings;
+  
+  for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+    mn[l] = mx[l] = v[1][l];
+    sum[l] = sumsq[l] = zc[l] = 0;
+  }
+  
+  for (int i = 1; i <= BIT_NFRAMES; i++) {
+    for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+      mn[l] = v[i][l] < mn[l] ? v[i][l] : mn[l];
+      mx[l] = v[i][l] > mx[l] ? v[i][l] : mx[l];
+      sum[l] += v[i][l];
+      sumsq[l] += v[i][l] * v[i][l];
+    }
+  }
+  
+  if (!ref->valid) {
+    for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+      ref->mean[l] = sum[l] / BIT_NFRAMES;
+      ref->last[l] = v[1][l];
+    }
+    ref->valid = true;
+  }
+  
+  double *mean = ref->mean;
+  for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+    v[0][l] = ref->last[l];
+  }
+  
+  for (int i = 1; i <= BIT_NFRAMES; i++) {
+    for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+      zc[l] += (v[i][l] - mean[l]) * (v[i - 1][l] - mean[l]) < 0 ? 1 : 0;
+    }
+  }
+  
+  for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+    mean[l] += (sum[l] / BIT_NFRAMES - mean[l]) * BIT_SUMMARY_REF_GAIN;
+    ref->last[l] = v[BIT_NFRAMES][l];
+  }
+  
+  block->count = BIT_NFRAMES;
+}
+
+void bitalino_summary_merge(t_bitalino_summary *acc,
+                            const t_bitalino_summary *block)
+{
+  bool first = acc->count == 0;
+  
+  for (int l = 0; l < BIT_SUMMARY_LANES; l++) {
+    acc->min[l] = first || block->min[l] < acc->min[l] ? block->min[l]
+                                                       : acc->min[l];
+    acc->max[l] = first || block->max[l] > acc->max[l] ? block->max[l]
+                                                       : acc->max[l];
+    acc->sum[l] += block->sum[l];
+    acc->sumsq[l] += block->sumsq[l];
+    acc->crossings[l] += block->crossings[l];
+  }
+  acc->count += block->count;
+}
+
+// outputs "/summary/Ax min max mean rms zero-crossings" for each channel,
+// rms is computed around the mean
+void bitalino_output_summary(t_bitalino *x)
+{
+  t_bitalino_summary acc;
+  
+  systhread_mutex_lock(x->qmutex);
+  acc = x->summary_acc;
+  bitalino_summary_reset(&x->summary_acc);
+  systhread_mutex_unlock(x->qmutex);
+  
+  if (acc.count == 0) return;
+  
+  t_atom values_out[5];
+  
+  for (int j = 0; j < 6; j++) {
+    double mean = acc.sum[j] / acc.count;
+    double var = acc.sumsq[j] / acc.count - mean * mean;
+    atom_setfloat(values_out, acc.min[j]);
+    atom_setfloat(values_out + 1, acc.max[j]);
+    atom_setfloat(values_out + 2, mean);
+    atom_setfloat(values_out + 3, var > 0 ? sqrt(var) : 0);
+    atom_setlong(values_out + 4, static_cast<long>(acc.crossings[j]));
+    outlet_anything(x->p_outlet, x->summary_messages_out[j], 5, values_out);
+  }
+}
+
+//============================ network output ================================//
+
+static char *bitalino_osc_int(char *p, int32_t value)
+{
+  uint32_t n = htonl(static_cast<uint32_t>(value));
+  memcpy(p, &n, 4);
+  return p + 4;
+}
+
+// NTP time tag, from a time on the steady clock timeline (ms)
+static char *bitalino_osc_timetag(t_bitalino *x, char *p, double time)
+{
+  double secs = (time + x->net.clock_offset) * 0.001 + BIT_OSC_NTP_UNIX_OFFSET;
+  double whole = floor(secs);
+  p = bitalino_osc_int(p, static_cast<int32_t>(static_cast<uint32_t>(whole)));
+  return bitalino_osc_int(p, static_cast<int32_t>(
+    static_cast<uint32_t>((secs - whole) * 4294967296.)));
+}
+
+// resolve @host and @port on the main thread, the acquisition thread only
+// opens the socket (see bitalino_net_update)
+void bitalino_net_resolve(t_bitalino *x)
+{
+  t_bitalino_net_address address;
+  address.valid = false;
+  
+  if (x->net_host != gensym("") && x->net_port > 0) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    char service[24];
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    snprintf(service, sizeof(service), "%ld", x->net_port);
+    
+    if (getaddrinfo(x->net_host->s_name, service, &hints, &res) != 0 ||
+        res == NULL) {
+      post("BITalino : unknown host %s", x->net_host->s_name);
+    } else {
+      memcpy(&address.addr, res->ai_addr, res->ai_addrlen);
+      address.addrlen = res->ai_addrlen;
+      address.valid = true;
+      freeaddrinfo(res);
+    }
+  }
+  
+  systhread_mutex_lock(x->mutex);
+  x->net_address = address;
+  x->net_changed = true;
+  systhread_mutex_unlock(x->mutex);
+}
+
+// (re)open the socket when the resolved address changed,
+// called from the acquisition thread with x->mutex held
+void bitalino_net_update(t_bitalino *x)
+{
+  if (!x->net_changed) return;
+  x->net_changed = false;
+  
+  bitalino_net_close(x);
+  x->net.address = x->net_address;
+  
+  if (!x->net.address.valid) return;
+  
+  x->net.sock = socket(x->net.address.addr.ss_family, SOCK_DGRAM, 0);
+  
+  if (x->net.sock == BIT_INVALID_SOCKET) {
+    post("BITalino : can't open OSC socket");
+    x->net.address.valid = false;
+  } else {
+    x->net.clock_offset = std::chrono::duration<double, std::milli>(
+      std::chrono::system_clock::now().time_since_epoch()).count() -
+      bitalino_now();
+  }
+}
+
+void bitalino_net_close(t_bitalino *x)
+{
+  if (x->net.sock != BIT_INVALID_SOCKET) {
+    bitalino_net_flush(x);
+    bitalino_closesocket(x->net.sock);
+    x->net.sock = BIT_INVALID_SOCKET;
+  }
+  x->net.address.valid = false;
+  x->net.size = 0;
+  x->net.nframes = 0;
+}
+
+// called from the acquisition thread with the last stamped frames
+void bitalino_net_push(t_bitalino *x)
+{
+  if (x->net.sock == BIT_INVALID_SOCKET) return;
+  
+  long bundle = x->net_bundle;
+  bundle = bundle < 1 ? 1 : (bundle > BIT_OSC_MAXBUNDLE ? BIT_OSC_MAXBUNDLE
+                                                       : bundle);
+  
+  for (int i = 0; i < BIT_NFRAMES; i++) {
+    const t_bitalino_stamped_frame &sf = x->stamped_frames[i];
+    
+    if (x->net.nframes == 0) {
+      char *p = x->net.buffer;
+      memcpy(p, "#bundle\0", 8);
+      p = bitalino_osc_int(p + 8, 0);
+      p = bitalino_osc_int(p, 1);             // "immediately"
+      x->net.size = p - x->net.buffer;
+      x->net.first_time = bitalino_now();
+    }
+    
+    // element size, bundle header, message size and
+    // "/bitalino" seq A1-A6 I1-I4
+    char *p = x->net.buffer + x->net.size;
+    p = bitalino_osc_int(p, BIT_OSC_FRAMESIZE - 4);
+    memcpy(p, "#bundle\0", 8);
+    p = bitalino_osc_timetag(x, p + 8, sf.time);
+    p = bitalino_osc_int(p, BIT_OSC_FRAMESIZE - 24);
+    memcpy(p, "/bitalino\0\0\0,iiiiiiiiiii\0\0\0\0", 28);
+    p += 28;
+    p = bitalino_osc_int(p, sf.frame.seq & BIT_SEQ_MASK);
+    for (int j = 0; j < 6; j++) {
+      p = bitalino_osc_int(p, sf.frame.analog[j]);
+    }
+    for (int j = 0; j < 4; j++) {
+      p = bitalino_osc_int(p, sf.frame.digital[j] ? 1 : 0);
+    }
+    
+    x->net.size = p - x->net.buffer;
+    x->net.nframes++;
+    
+    if (x->net.nframes >= bundle) {
+      bitalino_net_flush(x);
+    }
+  }
+  
+  if (x->net.nframes > 0 &&
+      bitalino_now() - x->net.first_time >= x->net_interval) {
+    bitalino_net_flush(x);
+  }
+}
+
+void bitalino_net_flush(t_bitalino *x)
+{
+  if (x->net.nframes == 0) return;
+  
+  if (sendto(x->net.sock, x->net.buffer, x->net.size, 0,
+             (struct sockaddr *)&x->net.address.addr,
+             x->net.address.addrlen) < 0) {
+    x->net.errors++;
   } else {
-    int val = n > 255 ? 255 : (n < 0 ? 0 : n);
-    x->pwmout_buffer.push(val);
-    if (x->pwmout_buffer.size() > BIT_MAXCTLFRAMES) {
-      x->pwmout_buffer.front();
-      x->pwmout_buffer.pop();
-    }
+    x->net.sent++;
   }
+  
+  x->net.size = 0;
+  x->net.nframes = 0;
 }
 
-void bitalino_trigger(t_bitalino *x, t_symbol *s, long argc, t_atom *argv) {
-  if (!x->connected) {
-    post("no BITalino connected");
+//================================ stats =====================================//
+
+static unsigned long long bitalino_thread_cpu_us(void)
+{
+#ifdef WIN32
+  FILETIME creation, exit, kernel, user;
+  GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (k.QuadPart + u.QuadPart) / 10;   // 100ns units
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
+void bitalino_stats_reset(t_bitalino *x)
+{
+  x->stats.frames = 0;
+  x->stats.lost = 0;
+  x->stats.overflows = 0;
+  x->stats.read_errors = 0;
+  x->stats.cpu_us = 0;
+  x->stats.last_frames = 0;
+  x->stats.last_cpu_us = 0;
+  x->stats.last_time = bitalino_now();
+  x->net.sent = 0;
+  x->net.errors = 0;
+}
+
+// rates are computed since the previous stats output
+void bitalino_stats(t_bitalino *x, t_symbol *s, long argc, t_atom *argv)
+{
+  if (argc > 0 && atom_getsym(argv) == gensym("reset")) {
+    bitalino_stats_reset(x);
     return;
   }
   
-  BITalino::Vbool dig;
-  for (int i = 0; i < 2; i++) {
-    dig.push_back(false);
-  }
-  if (x->bitalino_version < 2) {
-    for (int i = 0; i < 2; i++) {
-      dig.push_back(false);
-    }
-  }
-  int tot = fmin(argc, 4);
-  for (int i = 0; i < tot; i++) {
-    dig[i] = atom_getlong(argv + i) > 0;
-  }
-  x->digiout_buffer.push(dig);
-  if (x->digiout_buffer.size() > BIT_MAXCTLFRAMES) {
-    x->digiout_buffer.front();
-    x->digiout_buffer.pop();
-  }
+  double now = bitalino_now();
+  double elapsed = now - x->stats.last_time;
+  unsigned long frames = x->stats.frames;
+  unsigned long long cpu_us = x->stats.cpu_us;
+  t_atom values_out[3];
+  
+  atom_setlong(values_out, frames);
+  atom_setfloat(values_out + 1, elapsed > 0 ?
+                (frames - x->stats.last_frames) * 1000. / elapsed : 0);
+  outlet_anything(x->p_outlet, gensym("/stats/frames"), 2, values_out);
+  
+  // percentage of one core used by the acquisition thread
+  atom_setfloat(values_out, elapsed > 0 ?
+                (cpu_us - x->stats.last_cpu_us) * 0.1 / elapsed : 0);
+  outlet_anything(x->p_outlet, gensym("/stats/cpu"), 1, values_out);
+  
+  atom_setlong(values_out, x->stats.lost);
+  atom_setlong(values_out + 1, x->stats.overflows);
+  atom_setlong(values_out + 2, x->stats.read_errors);
+  outlet_anything(x->p_outlet, gensym("/stats/drops"), 3, values_out);
+  
+  // all buffers have a fixed capacity, their filling is what can grow
+  systhread_mutex_lock(x->qmutex);
+  atom_setlong(values_out, x->frame_buffer->size());
+  atom_setlong(values_out + 1, x->frame_buffer->capacity());
+  systhread_mutex_unlock(x->qmutex);
+  outlet_anything(x->p_outlet, gensym("/stats/queue"), 2, values_out);
+  
+  atom_setlong(values_out, x->net.sent);
+  atom_setlong(values_out + 1, x->net.errors);
+  outlet_anything(x->p_outlet, gensym("/stats/net"), 2, values_out);
+  
+  x->stats.last_frames = frames;
+  x->stats.last_cpu_us = cpu_us;
+  x->stats.last_time = now;
 }
 
 //------------------------------------------------------------------------------
 
 void *bitalino_get(t_bitalino *x)
 {
+  bool resolved_busy = false;   // holds the port found for "unknown"
+  // bitalino_start doesn't touch the settings while the thread runs,
+  // but the main thread reads them : only the local copy is resolved
+  std::string portname = x->bitalino_portname;
+  
   try {
         
 #ifdef WIN32
@@ -342,19 +1607,37 @@ void *bitalino_get(t_bitalino *x)
     
 #else
 
-    if (x->bitalino_portname == "unknown") {
-      x->bitalino_portname = "/dev/tty.BITalino-DevB";
+    if (portname == "unknown") {
+      // a port is reserved before it is probed : the device of a port used
+      // by another object is streaming and must not be opened again
+      bool found = false;
+      portname = "/dev/tty.BITalino-DevB";
       x->bitalino_version = 2;
 
-      try {
-        BITalino dev(x->bitalino_portname.c_str());
-      } catch (BITalino::Exception &e) {
-        x->bitalino_portname = "/dev/tty.bitalino-DevB";
+      if (bitalino_port_acquire(portname)) {
+        try {
+          BITalino dev(portname.c_str());
+          found = true;
+        } catch (BITalino::Exception &e) {
+          bitalino_port_release(portname);
+        }
+      }
+      
+      if (!found) {
+        portname = "/dev/tty.bitalino-DevB";
         x->bitalino_version = 1;
+        
+        if (!bitalino_port_acquire(portname)) {
+          post("BITalino : port already used");
+          bitalino_port_release(x->busy_portname);
+          x->running = false;
+          return NULL;
+        }
       }
+      resolved_busy = true;
     }
     
-    BITalino dev(x->bitalino_portname.c_str());
+    BITalino dev(portname.c_str());
     x->connected = true;
 
 #endif //WIN32
@@ -380,20 +1663,19 @@ void *bitalino_get(t_bitalino *x)
     if (x->bitalino_version < 2) {
       outputs.push_back(false);
       outputs.push_back(false);
-      x->digital_messages_out[2] = "/I3";
-      x->digital_messages_out[3] = "/I4";
-    } else {
-      x->digital_messages_out[2] = "/O1";
-      x->digital_messages_out[3] = "/O2";
     }
     
-    dev.start(1000, chans);
+    dev.start(BIT_SAMPLING_RATE, chans);
     dev.trigger(outputs);
     
-    busy_bitalinos[x->bitalino_portname] = true;
-    x->systhread_cancel = false;
+    bitalino_clock_reset(&x->clock_model);
+    x->clock_model.period = BIT_SAMPLE_PERIOD;
+    
     post("BITalino : connected to device");
     
+    unsigned long long cpu_us = bitalino_thread_cpu_us();
+    bool reading = false;
+    
     while (1) {
         
       // test if we're being asked to die, and if so return before we do the work
@@ -405,15 +1687,24 @@ void *bitalino_get(t_bitalino *x)
       
       systhread_mutex_lock(x->mutex);
       
+      bitalino_net_update(x);
+      
       // these calls need the device not to be in acquisition :
       
       if (x->query_state || x->bat_threshold >= 0) {
-        dev.stop();
+        try {
+          dev.stop();
+        } catch (BITalino::Exception &e) {
+          post("BITalino exception: %s\n", e.getDescription());
+          systhread_mutex_unlock(x->mutex);
+          break;
+        }
         if (x->query_state) {
           try {
             x->state = dev.state();
             x->query_state = false;
             x->got_state = true;
+            bitalino_probe(x, BIT_LATENCY_COMMAND_WIRE, x->state_time);
           } catch (BITalino::Exception &e) {
             post("BITalino exception %s\n", e.getDescription());
             
@@ -426,6 +1717,7 @@ void *bitalino_get(t_bitalino *x)
           try {
             dev.battery(x->bat_threshold);
             x->bat_threshold = -1;
+            bitalino_probe(x, BIT_LATENCY_COMMAND_WIRE, x->bat_time);
           } catch (BITalino::Exception &e) {
             post("BITalino exception %s\n", e.getDescription());
 
@@ -434,16 +1726,44 @@ void *bitalino_get(t_bitalino *x)
             }
           }
         }
-        dev.start(1000, chans);
+        try {
+          dev.start(BIT_SAMPLING_RATE, chans);
+        } catch (BITalino::Exception &e) {
+          post("BITalino exception: %s\n", e.getDescription());
+          systhread_mutex_unlock(x->mutex);
+          break;
+        }
+        // acquisition restarted : sample counter and timeline are re-anchored,
+        // and the group doesn't interpolate over the samples never taken
+        bitalino_clock_reset(&x->clock_model);
+        bitalino_group_stop(x);
       }
       
       // replaced "while" by "if" to avoid freezing when buffer is full
       // (too many messages in), for pwmout and digiout
       
-      if (x->pwmout_buffer.size() > 0) {
+      t_bitalino_pwm_command pwm_cmd;
+      t_bitalino_trigger_command trigger_cmd;
+      bool has_pwm = false;
+      bool has_trigger = false;
+      
+      systhread_mutex_lock(x->cmutex);
+      if (!x->pwmout_buffer.empty()) {
+        pwm_cmd = x->pwmout_buffer.front();
+        x->pwmout_buffer.pop();
+        has_pwm = true;
+      }
+      if (!x->digiout_buffer.empty()) {
+        trigger_cmd = x->digiout_buffer.front();
+        x->digiout_buffer.pop();
+        has_trigger = true;
+      }
+      systhread_mutex_unlock(x->cmutex);
+      
+      if (has_pwm) {
         try {
-          dev.pwm(x->pwmout_buffer.front());
-          x->pwmout_buffer.pop();
+          dev.pwm(pwm_cmd.value);
+          bitalino_probe(x, BIT_LATENCY_COMMAND_WIRE, pwm_cmd.time);
         } catch (BITalino::Exception &e) {
           post("BITalino exception %s\n", e.getDescription());
           
@@ -453,10 +1773,14 @@ void *bitalino_get(t_bitalino *x)
         }
       }
       
-      if (x->digiout_buffer.size() > 0) {
+      if (has_trigger) {
         try {
-          dev.trigger(x->digiout_buffer.front());
-          x->digiout_buffer.pop();
+          // reuse outputs, sized for the board version at connection
+          for (size_t i = 0; i < outputs.size(); i++) {
+            outputs[i] = trigger_cmd.value[i];
+          }
+          dev.trigger(outputs);
+          bitalino_probe(x, BIT_LATENCY_COMMAND_WIRE, trigger_cmd.time);
         } catch (BITalino::Exception &e) {
           post("BITalino exception %s\n", e.getDescription());
           
@@ -468,6 +1792,11 @@ void *bitalino_get(t_bitalino *x)
       
       if (!x->automatic) {
         systhread_mutex_unlock(x->mutex);
+        // no more frames from this board : don't hold back its group
+        if (reading) {
+          bitalino_group_stop(x);
+          reading = false;
+        }
         qelem_set(x->qelem);	// notify main thread using qelem mechanism
         systhread_sleep(x->sleeptime);
         continue;
@@ -475,10 +1804,18 @@ void *bitalino_get(t_bitalino *x)
       
       //============== if @automatic is on, continue ==============//
       
+      bool got_frames = false;
+      
       try {
         dev.read(*(x->frames));
+        // 0 while probes are off, so that the block isn't measured later
+        x->read_time = x->probes ? bitalino_now() : 0;
+        bitalino_clock_update(&x->clock_model, *(x->frames), bitalino_now(),
+                              x->stamped_frames);
+        got_frames = true;
       } catch (BITalino::Exception &e) {
         post("BITalino exception: %s\n", e.getDescription());
+        x->stats.read_errors++;
           
         if (e.code == BITalino::Exception::CONTACTING_DEVICE) {
           systhread_mutex_unlock(x->mutex);
@@ -488,24 +1825,51 @@ void *bitalino_get(t_bitalino *x)
       }
       
       systhread_mutex_unlock(x->mutex);
+      
+      if (got_frames) {
+        reading = true;
+        bitalino_group_push(x);
+        bitalino_net_push(x);
+        
+        x->stats.frames += BIT_NFRAMES;
+        x->stats.lost += x->clock_model.lost;
+        x->clock_model.lost = 0;
+      }
+      
+      unsigned long long now_cpu_us = bitalino_thread_cpu_us();
+      x->stats.cpu_us += now_cpu_us - cpu_us;
+      cpu_us = now_cpu_us;
+      
       qelem_set(x->qelem);	// notify main thread using qelem mechanism
       systhread_sleep(x->sleeptime);
     }
     
     dev.stop();
+    bitalino_net_close(x);
+    bitalino_group_stop(x);
     post("BITalino : disconnected from device");
     x->connected = false;
-    busy_bitalinos[x->bitalino_portname] = false;
-    // reset cancel flag for next time, in case the thread is created again
-    x->systhread_cancel = false;
+    if (resolved_busy) {
+      bitalino_port_release(portname);
+    }
+    bitalino_port_release(x->busy_portname);
+    x->running = false;
     systhread_exit(0);
     // this can return a value to systhread_join();
     return NULL;
     
   } catch (BITalino::Exception &e) {
     post("BITalino exception: %s\n", e.getDescription());
-    busy_bitalinos[x->bitalino_portname] = false;
-    bitalino_stop(x);
+    bitalino_net_close(x);
+    bitalino_group_stop(x);
+    x->connected = false;
+    if (resolved_busy) {
+      bitalino_port_release(portname);
+    }
+    bitalino_port_release(x->busy_portname);
+    // the thread can't join itself : bitalino_start or bitalino_stop will
+    bitalino_nopoll(x);
+    x->running = false;
     // this can return a value to systhread_join();
     return NULL;
   }
@@ -518,15 +1882,37 @@ void bitalino_qfn(t_bitalino *x)
   if (x->frame_zero_id != (*x->frames)[0].seq) {
     x->frame_zero_id = (*x->frames)[0].seq;
         
+    t_bitalino_queued_frame qf;
+    qf.time = 0;
+    if (x->probes) {
+      qf.time = bitalino_now();
+      bitalino_probe(x, BIT_LATENCY_READ_QUEUE, x->read_time);
+    }
+    
+    // SUMMARY MODE
+    if (x->summary) {
+      t_bitalino_summary block;
+      bitalino_summary_block(&block, &x->summary_ref, *x->frames);
+      
+      systhread_mutex_lock(x->qmutex);
+      bitalino_summary_merge(&x->summary_acc, &block);
+      systhread_mutex_unlock(x->qmutex);
+      
+      systhread_mutex_unlock(x->mutex);
+      return;
+    }
+    
     systhread_mutex_lock(x->qmutex);
     for (int i=0; i<BIT_NFRAMES; i++) {
-      x->frame_buffer->push((*x->frames)[i]);
+      qf.frame = (*x->frames)[i];
+      if (!x->frame_buffer->push(qf)) {
+        x->stats.overflows++;
+      }
     }
 
     // CONTINUOUS MODE
     if (x->continuous) {
       while (x->frame_buffer->size() > BIT_MAXFRAMES) {
-        x->frame_buffer->front();
         x->frame_buffer->pop();
       }
     }
@@ -539,7 +1925,7 @@ void bitalino_qfn(t_bitalino *x)
 
 void bitalino_clock(t_bitalino *x)
 {
-  if (x->continuous) {
+  if (x->continuous || x->summary) {
     clock_fdelay(x->m_poll, x->poll_interval);
   } else {
     clock_fdelay(x->m_poll, static_cast<double>(BIT_ASYNC_POLL_INTERVAL));
@@ -549,76 +1935,138 @@ void bitalino_clock(t_bitalino *x)
 
 void bitalino_bang(t_bitalino *x)
 {
+  bitalino_group_output(x);
+  
   if (x->got_state) {
+    // the thread writes the state under x->mutex
+    systhread_mutex_lock(x->mutex);
     const BITalino::State s = x->state;
+    x->got_state = false;
+    systhread_mutex_unlock(x->mutex);
     t_atom value_out;
-    std::string msgOutStr;
 
     for (int i = 0; i < 6; i++) {
       atom_setlong(&value_out, s.analog[i]);
-      msgOutStr = "/state" + std::string(x->analog_messages_out[i]);
-      outlet_anything(x->p_outlet, gensym(msgOutStr.c_str()), 1, &value_out);
+      outlet_anything(x->p_outlet, x->analog_state_messages_out[i],
+                      1, &value_out);
     }
 
     atom_setlong(&value_out, s.battery);
-    outlet_anything(x->p_outlet, gensym("/state/battery"), 1, &value_out);
+    outlet_anything(x->p_outlet, bitalino_sym_battery, 1, &value_out);
 
     atom_setlong(&value_out, s.batThreshold);
-    outlet_anything(x->p_outlet, gensym("/state/battery_threshold"), 1, &value_out);
+    outlet_anything(x->p_outlet, bitalino_sym_battery_threshold,
+                    1, &value_out);
     
     for (int i = 0; i < 4; i++) {
       atom_setlong(&value_out, s.digital[i] ? 1 : 0);
-      msgOutStr = "/state" + std::string(x->analog_messages_out[i]);
-      outlet_anything(x->p_outlet, gensym(msgOutStr.c_str()), 1, &value_out);
+      outlet_anything(x->p_outlet, x->digital_state_messages_out[i],
+                      1, &value_out);
     }
-    
-    x->got_state = false;
   }
   
   if (!x->automatic) return;
   
+  // SUMMARY MODE
+  if (x->summary) {
+    bitalino_output_summary(x);
+    return;
+  }
+  
   // CONTINUOUS MODE
   if (x->continuous) {
+    t_bitalino_queued_frame qf;
+    bool has_frame = false;
+    
+    // copy the frame so that bitalino_qfn can't overwrite it while output
+    systhread_mutex_lock(x->qmutex);
     if (!x->frame_buffer->empty()) {
-      const BITalino::Frame &f = x->frame_buffer->front();
-      t_atom value_out;
-      for (int j = 0; j < 6; j++) {
-        atom_setfloat(&value_out, f.analog[j]);
-        outlet_anything(x->p_outlet, gensym(x->analog_messages_out[j]),
-                        1, &value_out);
-      }
-      for (int j = 0; j < 4; j++) {
-        atom_setfloat(&value_out, f.digital[j]);
-        outlet_anything(x->p_outlet, gensym(x->digital_messages_out[j]),
-                        1, &value_out);
-      }
+      qf = x->frame_buffer->front();
+      has_frame = true;
       
-      systhread_mutex_lock(x->qmutex);
-      
-      if (x->frame_buffer->size() > 1 && !x->frame_buffer->empty()) {
+      if (x->frame_buffer->size() > 1) {
         x->frame_buffer->pop();
+      } else {
+        // only the first output of a frame counts
+        x->frame_buffer->front().time = 0;
       }
-      systhread_mutex_unlock(x->qmutex);
+    }
+    systhread_mutex_unlock(x->qmutex);
+    
+    if (has_frame) {
+      bitalino_output_frame(x, qf.frame);
+      bitalino_probe(x, BIT_LATENCY_QUEUE_OUTPUT, qf.time);
     }
     
   } else {
-    systhread_mutex_lock(x->qmutex);
-    while (!x->frame_buffer->empty()) {
-      const BITalino::Frame &f = x->frame_buffer->front();
-      t_atom value_out;
-      for (int j = 0; j < 6; j++) {
-        atom_setfloat(&value_out, f.analog[j]);
-        outlet_anything(x->p_outlet, gensym(x->analog_messages_out[j]),
-                        1, &value_out);
-      }
-      for (int j = 0; j < 4; j++) {
-        atom_setfloat(&value_out, f.digital[j]);
-        outlet_anything(x->p_outlet, gensym(x->digital_messages_out[j]),
-                        1, &value_out);
+    // qmutex is released around the outlet calls : objects downstream
+    // can call back into this one (e.g. stats)
+    t_bitalino_queued_frame qf;
+    
+    while (1) {
+      systhread_mutex_lock(x->qmutex);
+      bool has_frame = !x->frame_buffer->empty();
+      if (has_frame) {
+        qf = x->frame_buffer->front();
+        x->frame_buffer->pop();
       }
-      x->frame_buffer->pop();
+      systhread_mutex_unlock(x->qmutex);
+      
+      if (!has_frame) break;
+      
+      bitalino_output_frame(x, qf.frame);
+      bitalino_probe(x, BIT_LATENCY_QUEUE_OUTPUT, qf.time);
     }
-    systhread_mutex_unlock(x->qmutex);
+  }
+}
+
+void bitalino_output_frame(t_bitalino *x, const BITalino::Frame &f)
+{
+  t_atom value_out;
+  double now = x->keepalive > 0 ? gettime() : 0;
+  t_symbol **digital_out =
+    x->digital_messages_out[x->bitalino_version < 2 ? 0 : 1];
+  
+  for (int j = 0; j < 6; j++) {
+    if (!bitalino_output_changed(x, j, f.analog[j], now)) continue;
+    atom_setfloat(&value_out, f.analog[j]);
+    outlet_anything(x->p_outlet, x->analog_messages_out[j], 1, &value_out);
+  }
+  for (int j = 0; j < 4; j++) {
+    if (!bitalino_output_changed(x, 6 + j, f.digital[j], now)) continue;
+    atom_setfloat(&value_out, f.digital[j]);
+    outlet_anything(x->p_outlet, digital_out[j], 1, &value_out);
+  }
+}
+
+// false if the channel is in onchange mode and its value didn't move more
+// than its deadband since last output (and keepalive didn't expire)
+bool bitalino_output_changed(t_bitalino *x, int channel, double value,
+                             double now)
+{
+  if (x->onchange[channel] && x->has_output[channel]) {
+    double band = channel < 6 ? x->deadband[channel] : 0;
+    bool expired = x->keepalive > 0 &&
+                   now - x->last_output_time[channel] >= x->keepalive;
+    
+    if (fabs(value - x->last_output[channel]) <= band && !expired) {
+      return false;
+    }
+  }
+  
+  x->has_output[channel] = true;
+  x->last_output[channel] = value;
+  x->last_output_time[channel] = now;
+  return true;
+}
+
+// next frame will be output entirely
+void bitalino_output_reset(t_bitalino *x)
+{
+  for (int i = 0; i < BIT_NCHANNELS; i++) {
+    x->has_output[i] = false;
+    x->last_output[i] = 0;
+    x->last_output_time[i] = 0;
   }
 }
 
@@ -645,6 +2093,25 @@ void bitalino_connect(t_bitalino *x, t_symbol *s, long argc, t_atom *argv)
 
 void bitalino_start(t_bitalino *x, t_symbol *s, long argc, t_atom *argv)
 {
+  // reap a thread that ended by itself (device lost or not found)
+  if (x->systhread != NULL && !x->running) {
+    bitalino_stop(x);
+  }
+  
+  // the thread reads the port settings below
+  if (x->systhread != NULL) {
+    post("BITalino : already connected, disconnect first");
+    return;
+  }
+  
+  bitalino_output_reset(x);
+  x->summary_ref.valid = false;
+  
+  // the socket was closed with the previous connection
+  systhread_mutex_lock(x->mutex);
+  x->net_changed = true;
+  systhread_mutex_unlock(x->mutex);
+  
   x->bitalino_version = 0;
   x->bitalino_id = 0;
   x->bitalino_mac = "";
@@ -701,23 +2168,39 @@ void bitalino_start(t_bitalino *x, t_symbol *s, long argc, t_atom *argv)
   }
   
   
-  if (busy_bitalinos.find(x->bitalino_portname) == busy_bitalinos.end()) {
-    busy_bitalinos[x->bitalino_portname] = false;
-  } else {
-    if (busy_bitalinos[x->bitalino_portname]) {
-      post("BITalino : port already used");
-      return;
-    } else {
-      // do nothing
-    }
+  // reserved until the thread ends
+  if (!bitalino_port_acquire(x->bitalino_portname)) {
+    post("BITalino : port already used");
+    return;
   }
+  x->busy_portname = x->bitalino_portname;
   
-  if (x->systhread == NULL) {
-    //post("starting thread");
-    systhread_create((method) bitalino_get, x, 0, 0, 0, &x->systhread);
+  //post("starting thread");
+  x->systhread_cancel = false;
+  x->running = true;
+  if (systhread_create((method) bitalino_get, x, 0, 0, 0, &x->systhread)) {
+    x->systhread = NULL;
+    x->running = false;
+    bitalino_port_release(x->busy_portname);
   }
 }
 
+bool bitalino_port_acquire(const std::string &port)
+{
+  systhread_mutex_lock(busy_bitalinos_mutex);
+  bool free = !busy_bitalinos[port];
+  busy_bitalinos[port] = true;
+  systhread_mutex_unlock(busy_bitalinos_mutex);
+  return free;
+}
+
+void bitalino_port_release(const std::string &port)
+{
+  systhread_mutex_lock(busy_bitalinos_mutex);
+  busy_bitalinos[port] = false;
+  systhread_mutex_unlock(busy_bitalinos_mutex);
+}
+
 void bitalino_disconnect(t_bitalino *x)
 {
   bitalino_stop(x);
@@ -733,8 +2216,8 @@ void bitalino_stop(t_bitalino *x)
     //post("stopping thread");
     x->systhread_cancel = true;			// tell the thread to stop
     systhread_join(x->systhread, &ret);	// wait for the thread to stop
-    //busy_bitalinos[x->bitalino_id] = false;
     x->systhread = NULL;
+    x->running = false;
   }
 }
 
@@ -763,28 +2246,38 @@ void bitalino_nopoll(t_bitalino *x)
 
 //======================= attribute getters / setters ========================//
 
-t_max_err bitalino_get_automatic(t_bitalino *x, t_object *attr,
-                                 long *argc, t_atom **argv)
+// on/off attributes that are also read by the acquisition thread
+static t_max_err bitalino_get_onoff(const std::atomic<unsigned char> &value,
+                                    long *argc, t_atom **argv)
 {
   if (argc && argv) {
     char alloc;
     if (atom_alloc(argc, argv, &alloc)) {
       return MAX_ERR_GENERIC;
     }
-    atom_setchar_array(*argc, *argv, 1, &x->automatic);
-    //post("automatic getter called");
+    unsigned char c = value;
+    atom_setchar_array(*argc, *argv, 1, &c);
   }
   return MAX_ERR_NONE;
 }
 
+t_max_err bitalino_get_automatic(t_bitalino *x, t_object *attr,
+                                 long *argc, t_atom **argv)
+{
+  //post("automatic getter called");
+  return bitalino_get_onoff(x->automatic, argc, argv);
+}
+
 t_max_err bitalino_set_automatic(t_bitalino *x, t_object *attr,
                                  long argc, t_atom *argv)
 {
   if(argc && argv) {
     unsigned char prev = x->automatic;
-    atom_getchar_array(argc, argv, 1, &x->automatic);
-    if (x->automatic != prev) {
-      if (x->automatic == 0) {
+    unsigned char automatic = prev;
+    atom_getchar_array(argc, argv, 1, &automatic);
+    x->automatic = automatic;
+    if (automatic != prev) {
+      if (automatic == 0) {
 //        bitalino_poll(x);
 //        post("polling enabled");
       } else {
@@ -792,9 +2285,173 @@ t_max_err bitalino_set_automatic(t_bitalino *x, t_object *attr,
 //        post("polling disabled");
       }
     }
-    //post("automatic setter called  with value %ld", x->automatic);
+    //post("automatic setter called  with value %ld", automatic);
+  }
+  return MAX_ERR_NONE;
+}
+
+
+
+t_max_err bitalino_set_group(t_bitalino *x, t_object *attr,
+                             long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    t_symbol *name = atom_getsym(argv);
+    if (name == x->group && x->group_member != NULL) {
+      return MAX_ERR_NONE;
+    }
+    
+    bitalino_group_leave(x);
+    x->group = name;
+    if (name != gensym("")) {
+      bitalino_group_join(x, name);
+    }
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err bitalino_get_probes(t_bitalino *x, t_object *attr,
+                              long *argc, t_atom **argv)
+{
+  return bitalino_get_onoff(x->probes, argc, argv);
+}
+
+t_max_err bitalino_set_probes(t_bitalino *x, t_object *attr,
+                              long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    unsigned char prev = x->probes;
+    unsigned char probes = prev;
+    atom_getchar_array(argc, argv, 1, &probes);
+    if (probes && !prev) {
+      for (int i = 0; i < BIT_LATENCY_NSTAGES; i++) {
+        bitalino_histogram_reset(x->latency + i);
+      }
+    }
+    x->probes = probes;
+  }
+  return MAX_ERR_NONE;
+}
+
+// a single value applies to all channels
+t_max_err bitalino_set_onchange(t_bitalino *x, t_object *attr,
+                                long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    for (int i = 0; i < BIT_NCHANNELS; i++) {
+      if (argc == 1 || i < argc) {
+        x->onchange[i] = atom_getlong(argv + (argc == 1 ? 0 : i)) != 0;
+      }
+    }
+    bitalino_output_reset(x);
+  }
+  return MAX_ERR_NONE;
+}
+
+// a single value applies to all analog channels
+t_max_err bitalino_set_deadband(t_bitalino *x, t_object *attr,
+                                long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    for (int i = 0; i < 6; i++) {
+      if (argc == 1 || i < argc) {
+        double band = atom_getfloat(argv + (argc == 1 ? 0 : i));
+        x->deadband[i] = band > 0 ? band : 0;
+      }
+    }
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err bitalino_get_summary(t_bitalino *x, t_object *attr,
+                               long *argc, t_atom **argv)
+{
+  return bitalino_get_onoff(x->summary, argc, argv);
+}
+
+t_max_err bitalino_set_summary(t_bitalino *x, t_object *attr,
+                               long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    unsigned char prev = x->summary;
+    unsigned char summary = prev;
+    atom_getchar_array(argc, argv, 1, &summary);
+    if (summary && !prev) {
+      systhread_mutex_lock(x->qmutex);
+      bitalino_summary_reset(&x->summary_acc);
+      systhread_mutex_unlock(x->qmutex);
+      x->summary_ref.valid = false;
+    }
+    x->summary = summary;
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err bitalino_set_host(t_bitalino *x, t_object *attr,
+                            long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    x->net_host = atom_getsym(argv);
+    bitalino_net_resolve(x);
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err bitalino_set_port(t_bitalino *x, t_object *attr,
+                            long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    long port = atom_getlong(argv);
+    x->net_port = port < 0 ? 0 : (port > 65535 ? 65535 : port);
+    bitalino_net_resolve(x);
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err bitalino_get_bundle(t_bitalino *x, t_object *attr,
+                              long *argc, t_atom **argv)
+{
+  if (argc && argv) {
+    char alloc;
+    if (atom_alloc(argc, argv, &alloc)) {
+      return MAX_ERR_GENERIC;
+    }
+    atom_setlong(*argv, x->net_bundle);
+  }
+  return MAX_ERR_NONE;
+}
+
+// a datagram must stay under the usual MTU
+t_max_err bitalino_set_bundle(t_bitalino *x, t_object *attr,
+                              long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    long bundle = atom_getlong(argv);
+    x->net_bundle = bundle < 1 ? 1 : (bundle > BIT_OSC_MAXBUNDLE ?
+                                      BIT_OSC_MAXBUNDLE : bundle);
   }
   return MAX_ERR_NONE;
 }
 
+t_max_err bitalino_get_sendinterval(t_bitalino *x, t_object *attr,
+                                    long *argc, t_atom **argv)
+{
+  if (argc && argv) {
+    char alloc;
+    if (atom_alloc(argc, argv, &alloc)) {
+      return MAX_ERR_GENERIC;
+    }
+    atom_setfloat(*argv, x->net_interval);
+  }
+  return MAX_ERR_NONE;
+}
 
+t_max_err bitalino_set_sendinterval(t_bitalino *x, t_object *attr,
+                                    long argc, t_atom *argv)
+{
+  if (argc && argv) {
+    double interval = atom_getfloat(argv);
+    x->net_interval = interval > 0 ? interval : 0;
+  }
+  return MAX_ERR_NONE;
+}
@@ -0,0 +1,255 @@
+/**
+ *
+ * @file bitalino.cpp
+ *
+ * @brief simulated boards, see bitalino.h
+ *
+ * Nothing is allocated after construction except by version() and find(),
+ * as with the real API. Open ports are counted by address.
+ *
+ */
+
+#include "bitalino.h"
+
+#include <math.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace fake_bitalino {
+  std::atomic<double> speed(1.);
+  std::atomic<double> read_failure(0.);
+  std::atomic<double> open_failure(0.);
+  std::atomic<double> frame_loss(0.);
+  std::atomic<double> drift(0.);
+  std::atomic<double> read_latency(0.);
+
+  std::atomic<long> open_devices(0);
+  std::atomic<unsigned long> frames(0);
+  std::atomic<unsigned long> commands(0);
+  std::atomic<unsigned long> shared_opens(0);
+
+  static std::atomic<unsigned long long> seeds(0x9E3779B97F4A7C15ULL);
+  static std::mutex ports_mutex;
+  static std::map<std::string, int> ports;      // open boards per address
+}
+
+static double fake_now(void)
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *BITalino::Exception::getDescription(void)
+{
+  switch (code) {
+    case INVALID_ADDRESS: return "The specified address is invalid.";
+    case BT_ADAPTER_NOT_FOUND: return "No Bluetooth adapter was found.";
+    case DEVICE_NOT_FOUND: return "The device could not be found.";
+    case CONTACTING_DEVICE: return "The computer lost communication with the device.";
+    case PORT_COULD_NOT_BE_OPENED: return "The communication port does not exist or it is already being used.";
+    case PORT_INITIALIZATION: return "The communication port could not be initialized.";
+    case DEVICE_NOT_IDLE: return "The device is not idle.";
+    case DEVICE_NOT_IN_ACQUISITION: return "The device is not in acquisition mode.";
+    case INVALID_PARAMETER: return "Invalid parameter.";
+    case NOT_SUPPORTED: return "Operation not supported by the device.";
+    default: return "Unknown error.";
+  }
+}
+
+BITalino::VDevInfo BITalino::find(void)
+{
+  return VDevInfo();
+}
+
+BITalino::BITalino(const char *address)
+  : v2(true), started(false), rate(1000), nchannels(6), sample(0),
+    start_time(0), period(1), clock_rate(1), threshold(0), pwm_value(0)
+{
+  seed = fake_bitalino::seeds.fetch_add(0x9E3779B97F4A7C15ULL);
+  memset(outputs, 0, sizeof(outputs));
+
+  if (strncmp(address, "/dev/tty.", 9) != 0) {
+    throw Exception(Exception::INVALID_ADDRESS);
+  }
+  if (random() < fake_bitalino::open_failure) {
+    throw Exception(Exception::DEVICE_NOT_FOUND);
+  }
+
+  v2 = strstr(address, "bitalino") == NULL;
+  port = address;
+  clock_rate = 1 + fake_bitalino::drift * 1e-6;
+  fake_bitalino::open_devices++;
+
+  std::lock_guard<std::mutex> lock(fake_bitalino::ports_mutex);
+  if (fake_bitalino::ports[port]++ > 0) {
+    fake_bitalino::shared_opens++;
+  }
+}
+
+BITalino::~BITalino()
+{
+  fake_bitalino::open_devices--;
+
+  std::lock_guard<std::mutex> lock(fake_bitalino::ports_mutex);
+  fake_bitalino::ports[port]--;
+}
+
+std::string BITalino::version(void)
+{
+  return v2 ? "BITalino_v5.2" : "BITalino_v3.1";
+}
+
+void BITalino::start(int samplingRate, const Vint &channels, bool simulated)
+{
+  if (started) {
+    throw Exception(Exception::DEVICE_NOT_IDLE);
+  }
+  if (samplingRate != 1 && samplingRate != 10 && samplingRate != 100 &&
+      samplingRate != 1000) {
+    throw Exception(Exception::INVALID_PARAMETER);
+  }
+  if (channels.size() > 6) {
+    throw Exception(Exception::INVALID_PARAMETER);
+  }
+
+  rate = samplingRate;
+  nchannels = channels.empty() ? 6 : static_cast<int>(channels.size());
+  sample = 0;
+  start_time = fake_now();
+  period = 1000. / rate / clock_rate / fake_bitalino::speed;
+  started = true;
+}
+
+void BITalino::stop(void)
+{
+  if (!started) {
+    throw Exception(Exception::DEVICE_NOT_IN_ACQUISITION);
+  }
+  started = false;
+}
+
+int BITalino::read(VFrame &frames)
+{
+  if (!started) {
+    throw Exception(Exception::DEVICE_NOT_IN_ACQUISITION);
+  }
+  if (random() < fake_bitalino::read_failure) {
+    throw Exception(Exception::CONTACTING_DEVICE);
+  }
+
+  double loss = fake_bitalino::frame_loss;
+
+  for (size_t i = 0; i < frames.size(); i++) {
+    if (loss > 0 && random() < loss) {
+      sample++;
+    }
+
+    Frame &f = frames[i];
+    double t = static_cast<double>(sample) / rate;
+    double taken = start_time + sample * period;
+
+    f.seq = static_cast<char>(sample & 0x0F);
+    for (int j = 0; j < 5; j++) {
+      f.analog[j] = j < nchannels ?
+        static_cast<short>(512 + 400 * sin(2 * M_PI * (j + 1) * t)) : 0;
+    }
+    f.analog[5] = nchannels > 5 ? static_cast<short>(fmod(taken * 10, 1000.))
+                                : 0;
+    for (int j = 0; j < 4; j++) {
+      f.digital[j] = ((sample >> (9 + j)) & 1) != 0;
+    }
+    sample++;
+  }
+
+  // samples come out of the board at the sampling rate of its clock, and
+  // reach the host some time later
+  sleep_until(start_time + sample * period +
+              random() * fake_bitalino::read_latency);
+  fake_bitalino::frames += frames.size();
+  return static_cast<int>(frames.size());
+}
+
+void BITalino::battery(int value)
+{
+  fake_bitalino::commands++;
+  if (started) {
+    throw Exception(Exception::DEVICE_NOT_IDLE);
+  }
+  if (value < 0 || value > 63) {
+    throw Exception(Exception::INVALID_PARAMETER);
+  }
+  threshold = value;
+}
+
+void BITalino::trigger(const Vbool &digitalOutput)
+{
+  fake_bitalino::commands++;
+  if (digitalOutput.size() != (v2 ? 2u : 4u)) {
+    throw Exception(Exception::INVALID_PARAMETER);
+  }
+  if (!v2 && !started) {
+    throw Exception(Exception::DEVICE_NOT_IN_ACQUISITION);
+  }
+  for (size_t i = 0; i < digitalOutput.size(); i++) {
+    outputs[i] = digitalOutput[i];
+  }
+}
+
+void BITalino::pwm(int pwmOutput)
+{
+  fake_bitalino::commands++;
+  if (!v2) {
+    throw Exception(Exception::NOT_SUPPORTED);
+  }
+  if (pwmOutput < 0 || pwmOutput > 255) {
+    throw Exception(Exception::INVALID_PARAMETER);
+  }
+  pwm_value = pwmOutput;
+}
+
+BITalino::State BITalino::state(void)
+{
+  fake_bitalino::commands++;
+  if (!v2) {
+    throw Exception(Exception::NOT_SUPPORTED);
+  }
+  if (started) {
+    throw Exception(Exception::DEVICE_NOT_IDLE);
+  }
+
+  State s;
+  for (int j = 0; j < 6; j++) {
+    s.analog[j] = 512;
+  }
+  s.battery = 800;
+  s.batThreshold = threshold;
+  s.digital[0] = false;
+  s.digital[1] = false;
+  s.digital[2] = outputs[0];
+  s.digital[3] = outputs[1];
+  return s;
+}
+
+// xorshift, one generator per board
+double BITalino::random(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (seed >> 11) * (1. / 9007199254740992.);
+}
+
+void BITalino::sleep_until(double ms)
+{
+  double wait = ms - fake_now();
+  if (wait <= 0) return;
+
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(wait / 1000);
+  ts.tv_nsec = static_cast<long>((wait - ts.tv_sec * 1000.) * 1000000.);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
@@ -0,0 +1,129 @@
+/**
+ *
+ * @file bitalino.h
+ *
+ * @brief simulated boards with the interface of the BITalino cpp API
+ *
+ * A board streams generated signals paced by the host clock, as if it was
+ * read from the serial port. Its clock can drift from the host's one and
+ * reads can come back late. A1-A5 are sines, A6 is the host time at which
+ * the sample was taken (tenths of ms modulo 1000), so that the alignment
+ * of boards can be checked. Boards with "bitalino" in lower case in their
+ * address are v1, the others are v2, like the names the object builds.
+ * Commands check the same preconditions as the real boards, so that a
+ * misuse from the object shows up as an exception. The fake_bitalino
+ * namespace holds settings and counters shared by all boards, including
+ * the ports opened while another board had them open.
+ *
+ */
+
+#ifndef _BITALINO_H_
+#define _BITALINO_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+class BITalino {
+public:
+  typedef std::vector<bool> Vbool;
+  typedef std::vector<int> Vint;
+
+  struct DevInfo {
+    std::string macAddr;
+    std::string name;
+  };
+  typedef std::vector<DevInfo> VDevInfo;
+
+  struct Frame {
+    char seq;
+    bool digital[4];
+    short analog[6];
+  };
+  typedef std::vector<Frame> VFrame;
+
+  struct State {
+    int analog[6];
+    int battery;
+    int batThreshold;
+    bool digital[4];
+  };
+
+  class Exception {
+  public:
+    enum Code {
+      INVALID_ADDRESS = 1,
+      BT_ADAPTER_NOT_FOUND,
+      DEVICE_NOT_FOUND,
+      CONTACTING_DEVICE,
+      PORT_COULD_NOT_BE_OPENED,
+      PORT_INITIALIZATION,
+      DEVICE_NOT_IDLE,
+      DEVICE_NOT_IN_ACQUISITION,
+      INVALID_PARAMETER,
+      NOT_SUPPORTED,
+      UNDEFINED
+    };
+
+    Code code;
+
+    Exception(Code c) : code(c) {}
+    const char *getDescription(void);
+  };
+
+  static VDevInfo find(void);
+
+  BITalino(const char *address);
+  ~BITalino();
+
+  std::string version(void);
+  void start(int samplingRate = 1000, const Vint &channels = Vint(),
+             bool simulated = false);
+  void stop(void);
+  int read(VFrame &frames);
+  void battery(int value = 0);
+  void trigger(const Vbool &digitalOutput = Vbool());
+  void pwm(int pwmOutput = 100);
+  State state(void);
+
+private:
+  double random(void);
+  void sleep_until(double ms);
+
+  std::string port;
+  bool v2;
+  bool started;
+  int rate;
+  int nchannels;
+  unsigned long sample;     // samples read since start
+  double start_time;        // host time of sample 0 (ms)
+  double period;            // host time between samples (ms)
+  double clock_rate;        // board clock / host clock
+  int threshold;
+  int pwm_value;
+  bool outputs[4];
+  unsigned long long seed;
+};
+
+namespace fake_bitalino {
+  // simulated time runs this many times faster than the host clock
+  extern std::atomic<double> speed;
+  // probability for a read to lose the device (CONTACTING_DEVICE)
+  extern std::atomic<double> read_failure;
+  // probability for a connection to fail
+  extern std::atomic<double> open_failure;
+  // probability for a frame to be lost (gap in the sequence numbers)
+  extern std::atomic<double> frame_loss;
+  // clock error of the boards opened from now on (ppm, > 0 = fast)
+  extern std::atomic<double> drift;
+  // reads come back up to this long after their last sample (ms)
+  extern std::atomic<double> read_latency;
+
+  extern std::atomic<long> open_devices;
+  extern std::atomic<unsigned long> frames;
+  extern std::atomic<unsigned long> commands;
+  // opened while already open (e.g. a streaming board probed again)
+  extern std::atomic<unsigned long> shared_opens;
+}
+
+#endif // _BITALINO_H_
@@ -0,0 +1,117 @@
+/**
+ *
+ * @file ext.h
+ *
+ * @brief host-side stand-in for the part of the Max SDK used by bitalino-max
+ *
+ * Only declarations matching the SDK are here, the implementation and the
+ * functions driving it from the tests are in max_stub.h / max_stub.cpp.
+ *
+ */
+
+#ifndef _EXT_H_
+#define _EXT_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define C74_EXPORT
+
+typedef long t_max_err;
+typedef long t_atom_long;
+typedef double t_atom_float;
+
+#define MAX_ERR_NONE 0
+#define MAX_ERR_GENERIC -1
+
+enum e_max_atomtypes {
+  A_NOTHING = 0,
+  A_LONG,
+  A_FLOAT,
+  A_SYM,
+  A_OBJ,
+  A_DEFLONG,
+  A_DEFFLOAT,
+  A_DEFSYM,
+  A_GIMME,
+  A_CANT
+};
+
+#define ASSIST_INLET 1
+#define ASSIST_OUTLET 2
+
+typedef struct _symbol {
+  char                *s_name;
+  void                *s_thing;
+} t_symbol;
+
+union word {
+  t_atom_long         w_long;
+  t_atom_float        w_float;
+  t_symbol            *w_sym;
+  void                *w_obj;
+};
+
+typedef struct _atom {
+  short               a_type;
+  union word          a_w;
+} t_atom;
+
+typedef struct _class t_class;
+
+typedef struct _object {
+  t_class             *o_class;
+} t_object;
+
+typedef void *(*method)(void *, ...);
+
+#define CLASS_BOX gensym("box")
+
+t_class *class_new(const char *name, const method mnew, const method mfree,
+                   long size, const method mmenu, short type, ...);
+t_max_err class_addmethod(t_class *c, const method m, const char *name, ...);
+t_max_err class_register(t_symbol *name_space, t_class *c);
+
+void *object_alloc(t_class *c);
+t_max_err object_free(void *x);
+
+void post(const char *fmt, ...);
+void error(const char *fmt, ...);
+void object_post(t_object *x, const char *fmt, ...);
+void object_error(t_object *x, const char *fmt, ...);
+
+void *outlet_new(void *x, const char *s);
+void *outlet_anything(void *o, t_symbol *s, short ac, t_atom *av);
+
+t_symbol *gensym(const char *s);
+
+t_max_err atom_setlong(t_atom *a, t_atom_long b);
+t_max_err atom_setfloat(t_atom *a, double b);
+t_max_err atom_setsym(t_atom *a, t_symbol *b);
+t_atom_long atom_getlong(const t_atom *a);
+t_atom_float atom_getfloat(const t_atom *a);
+t_symbol *atom_getsym(const t_atom *a);
+long atom_gettype(const t_atom *a);
+t_max_err atom_alloc(long *ac, t_atom **av, char *alloc);
+t_max_err atom_setchar_array(long ac, t_atom *av, long count,
+                             unsigned char *vals);
+t_max_err atom_getchar_array(long ac, t_atom *av, long count,
+                             unsigned char *vals);
+
+void *sysmem_newptr(long size);
+void sysmem_freeptr(void *ptr);
+
+void *qelem_new(void *obj, method fn);
+void qelem_set(void *q);
+void qelem_unset(void *q);
+void qelem_free(void *q);
+
+void *clock_new(void *obj, method fn);
+void clock_fdelay(void *c, double time);
+void clock_unset(void *c);
+
+t_atom_long gettime(void);
+
+#endif // _EXT_H_
@@ -0,0 +1,52 @@
+/**
+ *
+ * @file ext_obex.h
+ *
+ * @brief host-side stand-in for the Max SDK attributes
+ *
+ * Attributes are registered by name with their type and offset, so that
+ * max_stub can set them from "@name value" arguments and messages, with
+ * the object's own accessors when it has some.
+ *
+ */
+
+#ifndef _EXT_OBEX_H_
+#define _EXT_OBEX_H_
+
+#include "ext.h"
+
+#define calcoffset(x, y) ((long)(size_t)(&(((x *)0L)->y)))
+
+t_max_err class_attr_stub(t_class *c, const char *name, char type,
+                          long offset, long size);
+t_max_err class_attr_stub_filter(t_class *c, const char *name,
+                                 double min, double max);
+t_max_err class_attr_stub_accessors(t_class *c, const char *name,
+                                    method getter, method setter);
+t_max_err attr_args_process(void *x, short ac, t_atom *av);
+
+#define CLASS_ATTR_CHAR(c, name, flags, s, m) \
+  class_attr_stub(c, name, 'c', calcoffset(s, m), 1)
+#define CLASS_ATTR_LONG(c, name, flags, s, m) \
+  class_attr_stub(c, name, 'l', calcoffset(s, m), 1)
+#define CLASS_ATTR_DOUBLE(c, name, flags, s, m) \
+  class_attr_stub(c, name, 'd', calcoffset(s, m), 1)
+#define CLASS_ATTR_SYM(c, name, flags, s, m) \
+  class_attr_stub(c, name, 's', calcoffset(s, m), 1)
+#define CLASS_ATTR_CHAR_ARRAY(c, name, flags, s, m, size) \
+  class_attr_stub(c, name, 'c', calcoffset(s, m), size)
+#define CLASS_ATTR_DOUBLE_ARRAY(c, name, flags, s, m, size) \
+  class_attr_stub(c, name, 'd', calcoffset(s, m), size)
+
+#define CLASS_ATTR_FILTER_MIN(c, name, min) \
+  class_attr_stub_filter(c, name, min, HUGE_VAL)
+#define CLASS_ATTR_FILTER_CLIP(c, name, min, max) \
+  class_attr_stub_filter(c, name, min, max)
+#define CLASS_ATTR_ACCESSORS(c, name, getter, setter) \
+  class_attr_stub_accessors(c, name, (method)(getter), (method)(setter))
+
+#define CLASS_ATTR_LABEL(c, name, flags, label)
+#define CLASS_ATTR_STYLE_LABEL(c, name, flags, style, label)
+#define CLASS_ATTR_DEFAULT(c, name, flags, value)
+
+#endif // _EXT_OBEX_H_
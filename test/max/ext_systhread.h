@@ -0,0 +1,32 @@
+/**
+ *
+ * @file ext_systhread.h
+ *
+ * @brief host-side stand-in for the Max SDK threads, on top of pthreads
+ *
+ * Mutexes check for errors : locking a mutex twice from the same thread
+ * aborts instead of hanging.
+ *
+ */
+
+#ifndef _EXT_SYSTHREAD_H_
+#define _EXT_SYSTHREAD_H_
+
+#include "ext.h"
+
+typedef void *t_systhread;
+typedef void *t_systhread_mutex;
+
+long systhread_create(method entryproc, void *arg, long stacksize,
+                      long priority, long flags, t_systhread *thread);
+long systhread_join(t_systhread thread, unsigned int *retval);
+void systhread_exit(long status);
+void systhread_sleep(long milliseconds);
+short systhread_ismainthread(void);
+
+long systhread_mutex_new(t_systhread_mutex *pmutex, long flags);
+long systhread_mutex_free(t_systhread_mutex pmutex);
+long systhread_mutex_lock(t_systhread_mutex pmutex);
+long systhread_mutex_unlock(t_systhread_mutex pmutex);
+
+#endif // _EXT_SYSTHREAD_H_
@@ -0,0 +1,849 @@
+/**
+ *
+ * @file max_stub.cpp
+ *
+ * @brief implementation of the Max SDK stand-in used by the tests
+ *
+ * Everything lives in fixed size tables and is allocated with malloc, so
+ * that operator new is only ever called by the object under test. The
+ * allocations made on behalf of the object (new symbols, sysmem, objects,
+ * threads and mutexes) are counted.
+ *
+ */
+
+#include "ext.h"
+#include "ext_obex.h"
+#include "ext_systhread.h"
+#include "max_stub.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+
+#define STUB_MAXCLASSES 4
+#define STUB_MAXMETHODS 32
+#define STUB_MAXATTRS 32
+#define STUB_MAXNAME 32
+#define STUB_MAXSLOTS 512        // clocks, qelems and outlets
+#define STUB_MAXSYMBOLS 4096     // power of 2
+#define STUB_MAXARGS 64
+#define STUB_MAXMESSAGE 1024
+#define STUB_SLEEP 0.5           // scheduler resolution (ms)
+
+typedef struct _stub_method {
+  char                name[STUB_MAXNAME];
+  method              fn;
+  long                type;
+} t_stub_method;
+
+typedef struct _stub_attr {
+  char                name[STUB_MAXNAME];
+  char                type;             // c(har) l(ong) d(ouble) s(ymbol)
+  long                offset;
+  long                size;
+  bool                filter;
+  double              min;
+  double              max;
+  method              getter;
+  method              setter;
+} t_stub_attr;
+
+struct _class {
+  char                name[STUB_MAXNAME];
+  method              mnew;
+  method              mfree;
+  long                size;
+  t_stub_method       methods[STUB_MAXMETHODS];
+  long                nmethods;
+  t_stub_attr         attrs[STUB_MAXATTRS];
+  long                nattrs;
+};
+
+typedef struct _stub_clock {
+  t_object            ob;               // so that object_free works on it
+  bool                used;
+  void                *owner;
+  method              fn;
+  bool                set;              // set and when protected by stub_mutex
+  double              when;
+} t_stub_clock;
+
+typedef struct _stub_qelem {
+  bool                used;
+  void                *owner;
+  method              fn;
+  std::atomic<bool>   set;
+} t_stub_qelem;
+
+typedef struct _stub_outlet {
+  bool                used;
+  void                *owner;
+  t_stub_outlet_fn    hook;
+  void                *ctx;
+} t_stub_outlet;
+
+static t_class stub_classes[STUB_MAXCLASSES];
+static long stub_nclasses = 0;
+static t_class stub_clock_class;
+
+static t_stub_clock stub_clocks[STUB_MAXSLOTS];
+static t_stub_qelem stub_qelems[STUB_MAXSLOTS];
+static t_stub_outlet stub_outlets[STUB_MAXSLOTS];
+
+static t_symbol *stub_symbols[STUB_MAXSYMBOLS];
+
+// clocks and symbols can be used from any thread
+static pthread_mutex_t stub_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t stub_symbols_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const pthread_t stub_main_thread = pthread_self();
+static const std::chrono::steady_clock::time_point stub_start =
+  std::chrono::steady_clock::now();
+
+static std::atomic<bool> stub_is_verbose(false);
+static std::atomic<unsigned long> stub_nposts(0);
+static std::atomic<unsigned long> stub_nallocations(0);
+
+static void stub_fatal(const char *what, int err)
+{
+  fprintf(stderr, "max stub : %s (%s)\n", what, strerror(err));
+  abort();
+}
+
+//============================== time ========================================//
+
+double stub_now(void)
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - stub_start).count();
+}
+
+t_atom_long gettime(void)
+{
+  return static_cast<t_atom_long>(stub_now());
+}
+
+static void stub_sleep(double ms)
+{
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(ms / 1000);
+  ts.tv_nsec = static_cast<long>((ms - ts.tv_sec * 1000.) * 1000000.);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+//============================== console =====================================//
+
+static void stub_vpost(const char *prefix, const char *fmt, va_list args)
+{
+  stub_nposts++;
+  if (!stub_is_verbose) return;
+
+  char line[1024];
+  vsnprintf(line, sizeof(line), fmt, args);
+  fprintf(stderr, "%s%s\n", prefix, line);
+}
+
+void post(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  stub_vpost("", fmt, args);
+  va_end(args);
+}
+
+void error(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  stub_vpost("error : ", fmt, args);
+  va_end(args);
+}
+
+void object_post(t_object *x, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  stub_vpost("", fmt, args);
+  va_end(args);
+}
+
+void object_error(t_object *x, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  stub_vpost("error : ", fmt, args);
+  va_end(args);
+}
+
+void stub_verbose(bool verbose)
+{
+  stub_is_verbose = verbose;
+}
+
+unsigned long stub_posts(void)
+{
+  return stub_nposts;
+}
+
+unsigned long stub_allocations(void)
+{
+  return stub_nallocations;
+}
+
+//============================== symbols =====================================//
+
+t_symbol *gensym(const char *s)
+{
+  unsigned long h = 2166136261u;
+  for (const char *c = s; *c; c++) {
+    h = (h ^ static_cast<unsigned char>(*c)) * 16777619u;
+  }
+
+  pthread_mutex_lock(&stub_symbols_mutex);
+
+  for (unsigned long i = 0; i < STUB_MAXSYMBOLS; i++) {
+    t_symbol **slot = stub_symbols + ((h + i) & (STUB_MAXSYMBOLS - 1));
+
+    if (*slot == NULL) {
+      stub_nallocations++;
+      t_symbol *sym = (t_symbol *)malloc(sizeof(t_symbol));
+      sym->s_name = strdup(s);
+      sym->s_thing = NULL;
+      *slot = sym;
+      pthread_mutex_unlock(&stub_symbols_mutex);
+      return sym;
+    }
+    if (strcmp((*slot)->s_name, s) == 0) {
+      pthread_mutex_unlock(&stub_symbols_mutex);
+      return *slot;
+    }
+  }
+
+  pthread_mutex_unlock(&stub_symbols_mutex);
+  stub_fatal("symbol table full", ENOMEM);
+  return NULL;
+}
+
+//=============================== atoms ======================================//
+
+t_max_err atom_setlong(t_atom *a, t_atom_long b)
+{
+  a->a_type = A_LONG;
+  a->a_w.w_long = b;
+  return MAX_ERR_NONE;
+}
+
+t_max_err atom_setfloat(t_atom *a, double b)
+{
+  a->a_type = A_FLOAT;
+  a->a_w.w_float = b;
+  return MAX_ERR_NONE;
+}
+
+t_max_err atom_setsym(t_atom *a, t_symbol *b)
+{
+  a->a_type = A_SYM;
+  a->a_w.w_sym = b;
+  return MAX_ERR_NONE;
+}
+
+t_atom_long atom_getlong(const t_atom *a)
+{
+  switch (a->a_type) {
+    case A_LONG: return a->a_w.w_long;
+    case A_FLOAT: return static_cast<t_atom_long>(a->a_w.w_float);
+    default: return 0;
+  }
+}
+
+t_atom_float atom_getfloat(const t_atom *a)
+{
+  switch (a->a_type) {
+    case A_LONG: return static_cast<t_atom_float>(a->a_w.w_long);
+    case A_FLOAT: return a->a_w.w_float;
+    default: return 0;
+  }
+}
+
+t_symbol *atom_getsym(const t_atom *a)
+{
+  return a->a_type == A_SYM ? a->a_w.w_sym : gensym("");
+}
+
+long atom_gettype(const t_atom *a)
+{
+  return a->a_type;
+}
+
+t_max_err atom_alloc(long *ac, t_atom **av, char *alloc)
+{
+  if (*ac > 0 && *av != NULL) {
+    *alloc = 0;
+  } else {
+    *ac = 1;
+    *av = (t_atom *)sysmem_newptr(sizeof(t_atom));
+    *alloc = 1;
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err atom_setchar_array(long ac, t_atom *av, long count,
+                             unsigned char *vals)
+{
+  for (long i = 0; i < ac && i < count; i++) {
+    atom_setlong(av + i, vals[i]);
+  }
+  return MAX_ERR_NONE;
+}
+
+t_max_err atom_getchar_array(long ac, t_atom *av, long count,
+                             unsigned char *vals)
+{
+  for (long i = 0; i < ac && i < count; i++) {
+    vals[i] = static_cast<unsigned char>(atom_getlong(av + i));
+  }
+  return MAX_ERR_NONE;
+}
+
+void *sysmem_newptr(long size)
+{
+  stub_nallocations++;
+  return malloc(size);
+}
+
+void sysmem_freeptr(void *ptr)
+{
+  free(ptr);
+}
+
+//============================== classes =====================================//
+
+t_class *class_new(const char *name, const method mnew, const method mfree,
+                   long size, const method mmenu, short type, ...)
+{
+  if (stub_nclasses == STUB_MAXCLASSES) {
+    stub_fatal("too many classes", ENOMEM);
+  }
+  t_class *c = stub_classes + stub_nclasses++;
+  snprintf(c->name, STUB_MAXNAME, "%s", name);
+  c->mnew = mnew;
+  c->mfree = mfree;
+  c->size = size;
+  c->nmethods = 0;
+  c->nattrs = 0;
+  return c;
+}
+
+// only the first argument type is used
+t_max_err class_addmethod(t_class *c, const method m, const char *name, ...)
+{
+  if (c->nmethods == STUB_MAXMETHODS) {
+    stub_fatal("too many methods", ENOMEM);
+  }
+  t_stub_method *sm = c->methods + c->nmethods++;
+  va_list args;
+  va_start(args, name);
+  sm->type = va_arg(args, int);
+  va_end(args);
+  snprintf(sm->name, STUB_MAXNAME, "%s", name);
+  sm->fn = m;
+  return MAX_ERR_NONE;
+}
+
+t_max_err class_register(t_symbol *name_space, t_class *c)
+{
+  return MAX_ERR_NONE;
+}
+
+static t_stub_attr *stub_find_attr(t_class *c, const char *name)
+{
+  for (long i = 0; i < c->nattrs; i++) {
+    if (strcmp(c->attrs[i].name, name) == 0) return c->attrs + i;
+  }
+  return NULL;
+}
+
+t_max_err class_attr_stub(t_class *c, const char *name, char type,
+                          long offset, long size)
+{
+  if (c->nattrs == STUB_MAXATTRS) {
+    stub_fatal("too many attributes", ENOMEM);
+  }
+  t_stub_attr *a = c->attrs + c->nattrs++;
+  memset(a, 0, sizeof(t_stub_attr));
+  snprintf(a->name, STUB_MAXNAME, "%s", name);
+  a->type = type;
+  a->offset = offset;
+  a->size = size;
+  return MAX_ERR_NONE;
+}
+
+t_max_err class_attr_stub_filter(t_class *c, const char *name,
+                                 double min, double max)
+{
+  t_stub_attr *a = stub_find_attr(c, name);
+  if (a == NULL) return MAX_ERR_GENERIC;
+  a->filter = true;
+  a->min = min;
+  a->max = max;
+  return MAX_ERR_NONE;
+}
+
+t_max_err class_attr_stub_accessors(t_class *c, const char *name,
+                                    method getter, method setter)
+{
+  t_stub_attr *a = stub_find_attr(c, name);
+  if (a == NULL) return MAX_ERR_GENERIC;
+  a->getter = getter;
+  a->setter = setter;
+  return MAX_ERR_NONE;
+}
+
+static void stub_attr_set(void *x, t_stub_attr *a, long ac, t_atom *av)
+{
+  t_atom filtered[STUB_MAXARGS];
+
+  if (ac > STUB_MAXARGS) ac = STUB_MAXARGS;
+
+  for (long i = 0; i < ac; i++) {
+    filtered[i] = av[i];
+    if (a->filter && av[i].a_type != A_SYM) {
+      double v = atom_getfloat(av + i);
+      v = v < a->min ? a->min : (v > a->max ? a->max : v);
+      if (av[i].a_type == A_LONG) {
+        atom_setlong(filtered + i, static_cast<t_atom_long>(v));
+      } else {
+        atom_setfloat(filtered + i, v);
+      }
+    }
+  }
+
+  if (a->setter != NULL) {
+    typedef t_max_err (*t_setter)(void *, void *, long, t_atom *);
+    ((t_setter)a->setter)(x, NULL, ac, filtered);
+    return;
+  }
+
+  char *p = (char *)x + a->offset;
+
+  for (long i = 0; i < ac && i < a->size; i++) {
+    switch (a->type) {
+      case 'c':
+        ((unsigned char *)p)[i] = (unsigned char)atom_getlong(filtered + i);
+        break;
+      case 'l':
+        ((t_atom_long *)p)[i] = atom_getlong(filtered + i);
+        break;
+      case 'd':
+        ((double *)p)[i] = atom_getfloat(filtered + i);
+        break;
+      case 's':
+        ((t_symbol **)p)[i] = atom_getsym(filtered + i);
+        break;
+    }
+  }
+}
+
+t_max_err attr_args_process(void *x, short ac, t_atom *av)
+{
+  t_class *c = ((t_object *)x)->o_class;
+
+  for (long i = 0; i < ac; i++) {
+    if (av[i].a_type != A_SYM || av[i].a_w.w_sym->s_name[0] != '@') continue;
+
+    long n = 0;
+    while (i + 1 + n < ac && !(av[i + 1 + n].a_type == A_SYM &&
+                               av[i + 1 + n].a_w.w_sym->s_name[0] == '@')) {
+      n++;
+    }
+
+    t_stub_attr *a = stub_find_attr(c, av[i].a_w.w_sym->s_name + 1);
+    if (a != NULL) {
+      stub_attr_set(x, a, n, av + i + 1);
+    }
+    i += n;
+  }
+  return MAX_ERR_NONE;
+}
+
+//============================== objects =====================================//
+
+void *object_alloc(t_class *c)
+{
+  stub_nallocations++;
+  t_object *x = (t_object *)calloc(1, c->size);
+  x->o_class = c;
+  return x;
+}
+
+t_max_err object_free(void *x)
+{
+  if (x == NULL) return MAX_ERR_NONE;
+
+  t_object *ob = (t_object *)x;
+
+  if (ob->o_class == &stub_clock_class) {
+    pthread_mutex_lock(&stub_mutex);
+    ((t_stub_clock *)x)->set = false;
+    ((t_stub_clock *)x)->used = false;
+    pthread_mutex_unlock(&stub_mutex);
+    return MAX_ERR_NONE;
+  }
+
+  if (ob->o_class->mfree != NULL) {
+    ((void (*)(void *))ob->o_class->mfree)(x);
+  }
+
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    if (stub_outlets[i].used && stub_outlets[i].owner == x) {
+      stub_outlets[i].used = false;
+    }
+  }
+
+  free(x);
+  return MAX_ERR_NONE;
+}
+
+// split a message in atoms, in place
+static long stub_parse(char *text, t_atom *av)
+{
+  long ac = 0;
+  char *p = text;
+
+  while (*p && ac < STUB_MAXARGS) {
+    while (*p == ' ') p++;
+    if (!*p) break;
+
+    char *token = p;
+    while (*p && *p != ' ') p++;
+    if (*p) *p++ = '\0';
+
+    char *end;
+    long l = strtol(token, &end, 10);
+    if (*end == '\0') {
+      atom_setlong(av + ac++, l);
+      continue;
+    }
+    double d = strtod(token, &end);
+    if (*end == '\0') {
+      atom_setfloat(av + ac++, d);
+      continue;
+    }
+    atom_setsym(av + ac++, gensym(strcmp(token, "\"\"") == 0 ? "" : token));
+  }
+  return ac;
+}
+
+t_object *stub_new(const char *classname, const char *args)
+{
+  char text[STUB_MAXMESSAGE];
+  t_atom av[STUB_MAXARGS];
+
+  for (long i = 0; i < stub_nclasses; i++) {
+    t_class *c = stub_classes + i;
+    if (strcmp(c->name, classname) != 0) continue;
+
+    snprintf(text, sizeof(text), "%s", args);
+    long ac = stub_parse(text, av);
+    typedef void *(*t_new)(t_symbol *, long, t_atom *);
+    return (t_object *)((t_new)c->mnew)(gensym(classname), ac, av);
+  }
+  return NULL;
+}
+
+void stub_free(t_object *x)
+{
+  object_free(x);
+}
+
+bool stub_send(t_object *x, const char *message)
+{
+  char text[STUB_MAXMESSAGE];
+  t_atom av[STUB_MAXARGS];
+  t_class *c = x->o_class;
+
+  snprintf(text, sizeof(text), "%s", message);
+  long ac = stub_parse(text, av);
+  if (ac == 0 || av[0].a_type != A_SYM) return false;
+
+  t_symbol *s = av[0].a_w.w_sym;
+
+  for (long i = 0; i < c->nmethods; i++) {
+    t_stub_method *m = c->methods + i;
+    if (strcmp(m->name, s->s_name) != 0) continue;
+
+    switch (m->type) {
+      case A_GIMME:
+        ((void (*)(void *, t_symbol *, long, t_atom *))m->fn)(x, s, ac - 1,
+                                                              av + 1);
+        return true;
+      case A_LONG:
+        ((void (*)(void *, long))m->fn)(x, ac > 1 ? atom_getlong(av + 1)
+                                                  : 0);
+        return true;
+      case A_FLOAT:
+        ((void (*)(void *, double))m->fn)(x, ac > 1 ? atom_getfloat(av + 1)
+                                                    : 0);
+        return true;
+      case A_NOTHING:
+        ((void (*)(void *))m->fn)(x);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  t_stub_attr *a = stub_find_attr(c, s->s_name);
+  if (a == NULL) return false;
+  stub_attr_set(x, a, ac - 1, av + 1);
+  return true;
+}
+
+//============================== outlets =====================================//
+
+void *outlet_new(void *x, const char *s)
+{
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_outlet *o = stub_outlets + i;
+    if (o->used) continue;
+    o->used = true;
+    o->owner = x;
+    o->hook = NULL;
+    o->ctx = NULL;
+    return o;
+  }
+  stub_fatal("too many outlets", ENOMEM);
+  return NULL;
+}
+
+void *outlet_anything(void *o, t_symbol *s, short ac, t_atom *av)
+{
+  t_stub_outlet *outlet = (t_stub_outlet *)o;
+  if (outlet->hook != NULL) {
+    outlet->hook(outlet->ctx, (t_object *)outlet->owner, s, ac, av);
+  }
+  return NULL;
+}
+
+void stub_outlet_hook(t_object *x, t_stub_outlet_fn fn, void *ctx)
+{
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_outlet *o = stub_outlets + i;
+    if (o->used && o->owner == x) {
+      o->hook = fn;
+      o->ctx = ctx;
+    }
+  }
+}
+
+//========================== clocks and qelems ===============================//
+
+void *clock_new(void *obj, method fn)
+{
+  pthread_mutex_lock(&stub_mutex);
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_clock *c = stub_clocks + i;
+    if (c->used) continue;
+    c->ob.o_class = &stub_clock_class;
+    c->used = true;
+    c->owner = obj;
+    c->fn = fn;
+    c->set = false;
+    pthread_mutex_unlock(&stub_mutex);
+    return c;
+  }
+  pthread_mutex_unlock(&stub_mutex);
+  stub_fatal("too many clocks", ENOMEM);
+  return NULL;
+}
+
+void clock_fdelay(void *c, double time)
+{
+  pthread_mutex_lock(&stub_mutex);
+  ((t_stub_clock *)c)->when = stub_now() + time;
+  ((t_stub_clock *)c)->set = true;
+  pthread_mutex_unlock(&stub_mutex);
+}
+
+void clock_unset(void *c)
+{
+  pthread_mutex_lock(&stub_mutex);
+  ((t_stub_clock *)c)->set = false;
+  pthread_mutex_unlock(&stub_mutex);
+}
+
+void *qelem_new(void *obj, method fn)
+{
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_qelem *q = stub_qelems + i;
+    if (q->used) continue;
+    q->used = true;
+    q->owner = obj;
+    q->fn = fn;
+    q->set = false;
+    return q;
+  }
+  stub_fatal("too many qelems", ENOMEM);
+  return NULL;
+}
+
+void qelem_set(void *q)
+{
+  ((t_stub_qelem *)q)->set = true;
+}
+
+void qelem_unset(void *q)
+{
+  ((t_stub_qelem *)q)->set = false;
+}
+
+void qelem_free(void *q)
+{
+  ((t_stub_qelem *)q)->set = false;
+  ((t_stub_qelem *)q)->used = false;
+}
+
+// one pass of the scheduler, returns the time of the next clock
+static double stub_service(void)
+{
+  t_stub_clock *due[STUB_MAXSLOTS];
+  int ndue = 0;
+  double now = stub_now();
+
+  pthread_mutex_lock(&stub_mutex);
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_clock *c = stub_clocks + i;
+    if (c->used && c->set && c->when <= now) {
+      c->set = false;
+      due[ndue++] = c;
+    }
+  }
+  pthread_mutex_unlock(&stub_mutex);
+
+  for (int i = 0; i < ndue; i++) {
+    if (due[i]->used) {
+      ((void (*)(void *))due[i]->fn)(due[i]->owner);
+    }
+  }
+
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_qelem *q = stub_qelems + i;
+    if (q->used && q->set.exchange(false)) {
+      ((void (*)(void *))q->fn)(q->owner);
+    }
+  }
+
+  double next = HUGE_VAL;
+  pthread_mutex_lock(&stub_mutex);
+  for (int i = 0; i < STUB_MAXSLOTS; i++) {
+    t_stub_clock *c = stub_clocks + i;
+    if (c->used && c->set && c->when < next) {
+      next = c->when;
+    }
+  }
+  pthread_mutex_unlock(&stub_mutex);
+  return next;
+}
+
+void stub_run(double ms)
+{
+  double end = stub_now() + ms;
+
+  while (1) {
+    double next = stub_service();
+    double now = stub_now();
+    if (now >= end) break;
+
+    double wait = (next < end ? next : end) - now;
+    stub_sleep(wait < STUB_SLEEP ? (wait > 0 ? wait : 0) : STUB_SLEEP);
+  }
+}
+
+//============================== threads =====================================//
+
+long systhread_create(method entryproc, void *arg, long stacksize,
+                      long priority, long flags, t_systhread *thread)
+{
+  stub_nallocations++;
+  pthread_t *t = (pthread_t *)malloc(sizeof(pthread_t));
+
+  if (pthread_create(t, NULL, (void *(*)(void *))entryproc, arg) != 0) {
+    free(t);
+    *thread = NULL;
+    return 1;
+  }
+  *thread = t;
+  return 0;
+}
+
+long systhread_join(t_systhread thread, unsigned int *retval)
+{
+  void *ret = NULL;
+  int err = pthread_join(*(pthread_t *)thread, &ret);
+  if (err != 0) {
+    stub_fatal("systhread_join", err);
+  }
+  free(thread);
+  if (retval != NULL) {
+    *retval = static_cast<unsigned int>(reinterpret_cast<size_t>(ret));
+  }
+  return 0;
+}
+
+void systhread_exit(long status)
+{
+  pthread_exit(reinterpret_cast<void *>(status));
+}
+
+void systhread_sleep(long milliseconds)
+{
+  stub_sleep(static_cast<double>(milliseconds));
+}
+
+short systhread_ismainthread(void)
+{
+  return pthread_equal(pthread_self(), stub_main_thread) ? 1 : 0;
+}
+
+long systhread_mutex_new(t_systhread_mutex *pmutex, long flags)
+{
+  stub_nallocations++;
+  pthread_mutex_t *m = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+  pthread_mutex_init(m, &attr);
+  pthread_mutexattr_destroy(&attr);
+  *pmutex = m;
+  return 0;
+}
+
+long systhread_mutex_free(t_systhread_mutex pmutex)
+{
+  pthread_mutex_destroy((pthread_mutex_t *)pmutex);
+  free(pmutex);
+  return 0;
+}
+
+long systhread_mutex_lock(t_systhread_mutex pmutex)
+{
+  int err = pthread_mutex_lock((pthread_mutex_t *)pmutex);
+  if (err != 0) {
+    stub_fatal("systhread_mutex_lock", err);
+  }
+  return 0;
+}
+
+long systhread_mutex_unlock(t_systhread_mutex pmutex)
+{
+  int err = pthread_mutex_unlock((pthread_mutex_t *)pmutex);
+  if (err != 0) {
+    stub_fatal("systhread_mutex_unlock", err);
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+/**
+ *
+ * @file max_stub.h
+ *
+ * @brief drives objects built against the Max SDK stand-in
+ *
+ * The thread calling stub_run plays the part of Max's main thread : it runs
+ * the clocks and qelems that are due. Messages and attributes are sent with
+ * their Max syntax, e.g. stub_send(x, "connect v2 b01") or
+ * stub_send(x, "summary 1"). Nothing here allocates with operator new, so
+ * that the allocation test only sees the object's own allocations.
+ *
+ */
+
+#ifndef _MAX_STUB_H_
+#define _MAX_STUB_H_
+
+#include "ext.h"
+
+// called with every message output by an object
+typedef void (*t_stub_outlet_fn)(void *ctx, t_object *x, t_symbol *s,
+                                 long ac, t_atom *av);
+
+// new object of a registered class, args as typed in a box
+t_object *stub_new(const char *classname, const char *args);
+void stub_free(t_object *x);
+
+// message or attribute name followed by its arguments,
+// "" is the empty symbol. false if x doesn't understand it.
+bool stub_send(t_object *x, const char *message);
+
+void stub_outlet_hook(t_object *x, t_stub_outlet_fn fn, void *ctx);
+
+// run clocks and qelems for ms milliseconds
+void stub_run(double ms);
+
+// milliseconds since the first call
+double stub_now(void);
+
+// post() is silent unless verbose
+void stub_verbose(bool verbose);
+unsigned long stub_posts(void);
+
+// allocations made on behalf of the objects : new symbols, sysmem pointers,
+// objects, threads and mutexes
+unsigned long stub_allocations(void);
+
+#endif // _MAX_STUB_H_
@@ -0,0 +1,287 @@
+/**
+ *
+ * @file test_alloc.cpp
+ *
+ * @brief no allocation while simulated boards stream
+ *
+ * The global operator new is replaced by one counting its calls, and so
+ * are malloc, calloc and realloc with glibc. Elsewhere, the C allocations
+ * counted are those of the Max stand-in (a gensym of a new string, sysmem).
+ * Each case connects objects to simulated boards and lets them stream
+ * before counting, then keeps sending commands while counting. Any
+ * allocation from the acquisition thread or the output path fails the
+ * case. Cases can also bound the read to queue latency reported by the
+ * probes.
+ *
+ */
+
+#include "ext.h"
+#include "max_stub.h"
+#include "bitalino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <atomic>
+
+#define ALLOC_WARMUP 500        // ms before counting
+#define ALLOC_MEASURE 2000      // ms
+#define ALLOC_COMMAND_INTERVAL 20
+#define ALLOC_MAXOBJECTS 2
+#define ALLOC_STALL 50          // ms without scheduler for "stall"
+
+int bitalino_main(void);
+
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned long> allocations(0);
+
+#ifdef __GLIBC__
+// the allocator behind malloc, which is replaced below
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+#define alloc_malloc __libc_malloc
+#else
+#define alloc_malloc malloc
+#endif
+
+static void *counted_new(size_t size)
+{
+  if (counting) {
+    allocations++;
+  }
+  return alloc_malloc(size > 0 ? size : 1);
+}
+
+#ifdef __GLIBC__
+extern "C" void *malloc(size_t size)
+{
+  if (counting) {
+    allocations++;
+  }
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  if (counting) {
+    allocations++;
+  }
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+  if (counting) {
+    allocations++;
+  }
+  return __libc_realloc(p, size);
+}
+#endif
+
+void *operator new(size_t size)
+{
+  void *p = counted_new(size);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  void *p = counted_new(size);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_new(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_new(size);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+#if __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+#endif
+
+// the allocations of the Max stand-in, when malloc doesn't see them
+static unsigned long alloc_stub_count(void)
+{
+#ifdef __GLIBC__
+  return 0;
+#else
+  return stub_allocations();
+#endif
+}
+
+static const char *alloc_commands[] = {
+  "pwm 100", "trigger 1 0", "getstate", "battery 10", "stats", "latency",
+  NULL
+};
+
+// probes are off long enough for a stale read time to show up in the max,
+// "stall" holds the scheduler back while the board keeps reading
+static const char *alloc_probes_commands[] = {
+  "probes 0", "pwm 100", "getstate", "battery 10", "stats", "stall",
+  "probes 1", "latency", "trigger 1 0", "latency", NULL
+};
+
+typedef struct _alloc_case {
+  const char          *name;
+  const char          *args[ALLOC_MAXOBJECTS];  // one object per entry
+  const char          *expect;    // must be output while counting
+  const char          **commands;
+  double              max_latency;  // read to queue bound (ms), 0 = none
+} t_alloc_case;
+
+static const t_alloc_case alloc_cases[] = {
+  { "continuous", { "@continuous 1", NULL }, "/A1", alloc_commands, 0 },
+  { "queued",     { "@continuous 0", NULL }, "/A1", alloc_commands, 0 },
+  { "summary",    { "@summary 1", NULL }, "/summary/A1", alloc_commands, 0 },
+  { "onchange",   { "@onchange 1 @deadband 20 @keepalive 100", NULL }, "/A1",
+                  alloc_commands, 0 },
+  { "probes",     { "@probes 1", NULL }, "/latency/read_queue",
+                  alloc_commands, 0 },
+  { "probes-off", { "@probes 1", NULL }, "/latency/read_queue",
+                  alloc_probes_commands, 50 },
+  { "group",      { "@group alloc", "@group alloc" }, "/group",
+                  alloc_commands, 0 },
+  { "osc",        { "@host 127.0.0.1 @port 9 @bundle 10 @sendinterval 5",
+                    NULL }, "/A1", alloc_commands, 0 },
+};
+
+typedef struct _alloc_counts {
+  t_symbol            *expect;
+  unsigned long       expected;
+  unsigned long       states;
+  long                net_sent;
+  double              max_latency;  // max of /latency/read_queue (ms)
+} t_alloc_counts;
+
+static void alloc_outlet(void *ctx, t_object *x, t_symbol *s,
+                         long ac, t_atom *av)
+{
+  t_alloc_counts *counts = (t_alloc_counts *)ctx;
+
+  if (s == counts->expect) {
+    counts->expected++;
+  }
+  if (s == gensym("/latency/read_queue") && ac >= 4) {
+    double max = atom_getfloat(av + 3);
+    if (max > counts->max_latency) counts->max_latency = max;
+  } else if (s == gensym("/state/battery")) {
+    counts->states++;
+  } else if (s == gensym("/stats/net") && ac > 0) {
+    counts->net_sent = atom_getlong(av);
+  }
+}
+
+static void alloc_run(t_object **objects, long nobjects, const char **commands,
+                      double ms, unsigned long *ncommands)
+{
+  long n = 0;
+  double end = stub_now() + ms;
+
+  while (commands[n] != NULL) n++;
+
+  while (stub_now() < end) {
+    const char *command = commands[*ncommands % n];
+    (*ncommands)++;
+
+    // the command following a stall comes before the scheduler catches up
+    if (strcmp(command, "stall") == 0) {
+      usleep(ALLOC_STALL * 1000);
+      continue;
+    }
+    for (long i = 0; i < nobjects; i++) {
+      stub_send(objects[i], command);
+    }
+    stub_run(ALLOC_COMMAND_INTERVAL);
+  }
+}
+
+static bool alloc_case(const t_alloc_case *c)
+{
+  t_object *objects[ALLOC_MAXOBJECTS];
+  t_alloc_counts counts;
+  long nobjects = 0;
+  unsigned long ncommands = 0;
+  char message[64];
+
+  memset(&counts, 0, sizeof(counts));
+  counts.expect = gensym(c->expect);
+
+  for (long i = 0; i < ALLOC_MAXOBJECTS && c->args[i] != NULL; i++) {
+    objects[i] = stub_new("bitalino", c->args[i]);
+    stub_outlet_hook(objects[i], alloc_outlet, &counts);
+    snprintf(message, sizeof(message), "connect v2 alloc%ld", i);
+    stub_send(objects[i], message);
+    nobjects++;
+  }
+
+  alloc_run(objects, nobjects, c->commands, ALLOC_WARMUP, &ncommands);
+
+  counts.expected = 0;
+  counts.states = 0;
+  counts.max_latency = 0;
+  allocations = 0;
+  unsigned long stub_count = alloc_stub_count();
+  counting = true;
+  alloc_run(objects, nobjects, c->commands, ALLOC_MEASURE, &ncommands);
+  counting = false;
+  allocations += alloc_stub_count() - stub_count;
+
+  for (long i = 0; i < nobjects; i++) {
+    stub_send(objects[i], "disconnect");
+    stub_free(objects[i]);
+  }
+
+  bool net = strstr(c->args[0], "@host") != NULL;
+  bool ok = allocations == 0 && counts.expected > 0 && counts.states > 0 &&
+            (!net || counts.net_sent > 0) &&
+            (c->max_latency <= 0 || counts.max_latency <= c->max_latency);
+
+  printf("%-12s %6lu allocations %8lu %-20s %4lu states",
+         c->name, allocations.load(), counts.expected, c->expect,
+         counts.states);
+  if (net) {
+    printf(" %6ld datagrams", counts.net_sent);
+  }
+  if (c->max_latency > 0) {
+    printf(" %8.3f ms max", counts.max_latency);
+  }
+  printf("%s\n", ok ? "" : "   FAILED");
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  stub_verbose(getenv("BITALINO_TEST_VERBOSE") != NULL);
+  bitalino_main();
+
+  bool ok = true;
+  const long n = sizeof(alloc_cases) / sizeof(alloc_cases[0]);
+
+  for (long i = 0; i < n; i++) {
+    if (argc > 1 && strcmp(argv[1], alloc_cases[i].name) != 0) continue;
+    ok = alloc_case(alloc_cases + i) && ok;
+  }
+
+  if (fake_bitalino::open_devices != 0) {
+    printf("%ld simulated boards still open\n",
+           fake_bitalino::open_devices.load());
+    ok = false;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/**
+ *
+ * @file test_group.cpp
+ *
+ * @brief boards with drifting clocks stay aligned in a sync group
+ *
+ * Two simulated boards whose clocks drift in opposite directions, and whose
+ * reads come back with a random latency, stream in the same group. A6 of
+ * the simulated boards is the host time at which each sample was taken (in
+ * tenths of ms), so the difference between the A6 values of both boards in
+ * a /group frame is their misalignment on the group timeline. getstate
+ * restarts the acquisition of one board from time to time, the board is
+ * then re-anchored on the timeline and has a looser bound for a while.
+ * /group/error must be output for both boards and stay within the read
+ * latency on average (its max follows the scheduling of the host, a read
+ * coming back late raises it for a while).
+ *
+ */
+
+#include "ext.h"
+#include "max_stub.h"
+#include "bitalino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define GROUP_DRIFT 100.            // ppm, + for one board, - for the other
+#define GROUP_LATENCY 4.            // max read latency (ms)
+#define GROUP_WARMUP 2000           // ms before measuring
+#define GROUP_MEASURE 10000         // ms
+#define GROUP_STEP 10
+#define GROUP_GETSTATE 2000         // ms between restarts of a board
+#define GROUP_SETTLE 250            // ms after a restart
+#define GROUP_MAXDIFF 1.5           // ms between the boards
+#define GROUP_MAXSETTLE 5.          // ms between the boards after a restart
+#define GROUP_MAXMEAN 0.5           // ms, mean of the absolute difference
+
+int bitalino_main(void);
+
+typedef struct _group_counts {
+  bool                measuring;
+  bool                settling;     // a board restarted recently
+  double              last[2];      // A6 in the previous /group frame
+  unsigned long       frames;       // /group frames with both boards
+  unsigned long       partial;      // /group frames missing a board
+  double              sum;          // of absolute differences (ms)
+  double              max;
+  double              max_settling;
+  unsigned long       errors;       // /group/error values
+  double              sum_error;
+  double              max_error;
+} t_group_counts;
+
+static void group_outlet(void *ctx, t_object *x, t_symbol *s,
+                         long ac, t_atom *av)
+{
+  t_group_counts *counts = (t_group_counts *)ctx;
+
+  if (!counts->measuring) return;
+
+  if (s == gensym("/group") && ac == 21) {
+    // boards not streaming output zeros, A1 of a streaming one is never 0
+    if (atom_getfloat(av + 1) == 0 || atom_getfloat(av + 11) == 0) {
+      counts->partial++;
+      return;
+    }
+
+    double a = atom_getfloat(av + 6);
+    double b = atom_getfloat(av + 16);
+    double da = a - counts->last[0];
+    double db = b - counts->last[1];
+    counts->last[0] = a;
+    counts->last[1] = b;
+
+    // A6 wraps every 100 ms : frames interpolated across the wrap, or
+    // following a gap, don't step by 1 ms and are skipped
+    if (fabs(da - 10) > 2 || fabs(db - 10) > 2) return;
+
+    // one board can wrap just before the other
+    double diff = fabs(fmod(a - b + 1500, 1000) - 500) * 0.1;
+    counts->frames++;
+    counts->sum += diff;
+    if (counts->settling) {
+      if (diff > counts->max_settling) counts->max_settling = diff;
+    } else if (diff > counts->max) {
+      counts->max = diff;
+    }
+  } else if (s == gensym("/group/error") && ac == 2) {
+    for (int i = 0; i < 2; i++) {
+      double error = atom_getfloat(av + i);
+      if (error < 0) continue;
+      counts->errors++;
+      counts->sum_error += error;
+      if (error > counts->max_error) counts->max_error = error;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  stub_verbose(getenv("BITALINO_TEST_VERBOSE") != NULL);
+  bitalino_main();
+
+  t_group_counts counts;
+  memset(&counts, 0, sizeof(counts));
+
+  fake_bitalino::read_latency = GROUP_LATENCY;
+
+  t_object *boards[2];
+  for (int i = 0; i < 2; i++) {
+    char message[64];
+    boards[i] = stub_new("bitalino", "@group drift");
+    stub_outlet_hook(boards[i], group_outlet, &counts);
+
+    // the drift is set when the board is opened by the acquisition thread
+    fake_bitalino::drift = i == 0 ? GROUP_DRIFT : -GROUP_DRIFT;
+    snprintf(message, sizeof(message), "connect v2 drift%d", i);
+    stub_send(boards[i], message);
+    stub_run(200);
+  }
+
+  double start = stub_now();
+  double next_getstate = start + GROUP_GETSTATE;
+  double restart = 0;
+  long restarts = 0;
+
+  while (stub_now() - start < GROUP_WARMUP + GROUP_MEASURE) {
+    stub_run(GROUP_STEP);
+    counts.measuring = stub_now() - start >= GROUP_WARMUP;
+    counts.settling = restarts > 0 && stub_now() - restart < GROUP_SETTLE;
+
+    if (stub_now() >= next_getstate) {
+      stub_send(boards[restarts % 2], "getstate");
+      restart = stub_now();
+      restarts++;
+      next_getstate += GROUP_GETSTATE;
+    }
+  }
+
+  for (int i = 0; i < 2; i++) {
+    stub_send(boards[i], "disconnect");
+    stub_free(boards[i]);
+  }
+  fake_bitalino::drift = 0;
+  fake_bitalino::read_latency = 0;
+
+  double mean = counts.frames > 0 ? counts.sum / counts.frames : 0;
+  double mean_error = counts.errors > 0 ? counts.sum_error / counts.errors : 0;
+  bool ok = counts.frames > GROUP_MEASURE / 2 && mean <= GROUP_MAXMEAN &&
+            counts.max <= GROUP_MAXDIFF &&
+            counts.max_settling <= GROUP_MAXSETTLE &&
+            mean_error > 0 && mean_error <= GROUP_LATENCY;
+
+  printf("drift %+.0f/%+.0f ppm, latency %.0f ms : %lu frames (%lu partial)\n"
+         "  difference mean %.3f max %.3f ms (%.3f ms after restarts)\n"
+         "  /group/error mean %.3f max %.3f ms%s\n",
+         GROUP_DRIFT, -GROUP_DRIFT, GROUP_LATENCY, counts.frames,
+         counts.partial, mean, counts.max, counts.max_settling, mean_error,
+         counts.max_error, ok ? "" : "   FAILED");
+
+  if (fake_bitalino::open_devices != 0) {
+    printf("%ld simulated boards still open\n",
+           fake_bitalino::open_devices.load());
+    ok = false;
+  }
+
+  return ok ? 0 : 1;
+}
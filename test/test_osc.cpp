@@ -0,0 +1,242 @@
+/**
+ *
+ * @file test_osc.cpp
+ *
+ * @brief OSC output decoded by a loopback receiver
+ *
+ * A UDP socket bound to 127.0.0.1 receives the datagrams of an object
+ * streaming from a simulated board. Every datagram is decoded : layout of
+ * the bundle and of its messages, datagram size, sequence numbers without
+ * gaps, increasing time tags close to the system clock, and frames per
+ * datagram as set by @bundle and @sendinterval. All frames read must be
+ * received.
+ *
+ */
+
+#include "ext.h"
+#include "max_stub.h"
+#include "bitalino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+
+#define OSC_RUN 2000                // ms of streaming per case
+#define OSC_STEP 10                 // ms between receiver polls
+#define OSC_MAXDATAGRAM 1456        // 15 frames, fits a 1500 bytes MTU
+#define OSC_FRAMESIZE 96            // bundle element holding one frame
+#define OSC_MAXCLOCKDIFF 1000.      // ms between time tags and system clock
+#define OSC_NTP_UNIX_OFFSET 2208988800.
+
+int bitalino_main(void);
+
+typedef struct _osc_case {
+  const char          *name;
+  const char          *args;
+  long                sizes[2];     // frames per datagram, 0 = unused
+} t_osc_case;
+
+// a read brings 20 frames : bundles flush at the end of each read unless
+// @sendinterval lets them wait for the next one
+static const t_osc_case osc_cases[] = {
+  { "default",      "", { 10, 0 } },
+  { "bundle-1",     "@bundle 1", { 1, 0 } },
+  { "bundle-15",    "@bundle 15", { 15, 5 } },
+  { "bundle-40",    "@bundle 40", { 15, 5 } },    // clipped to 15
+  { "sendinterval", "@bundle 15 @sendinterval 50", { 15, 0 } },
+};
+
+typedef struct _osc_receiver {
+  int                 sock;
+  unsigned long       datagrams;
+  unsigned long       frames;
+  unsigned long       errors;       // malformed datagrams
+  unsigned long       gaps;         // missing sequence numbers
+  unsigned long       backwards;    // time tags not increasing
+  unsigned long       late;         // time tags far from the system clock
+  unsigned long       unexpected;   // datagrams not of the expected size
+  long                max_size;     // bytes
+  int                 last_seq;
+  double              last_time;    // ms since 1970
+  long                counts[16];   // datagrams per number of frames
+} t_osc_receiver;
+
+static double osc_system_ms(void)
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int32_t osc_int(const unsigned char *p)
+{
+  uint32_t n;
+  memcpy(&n, p, 4);
+  return static_cast<int32_t>(ntohl(n));
+}
+
+// ms since 1970
+static double osc_timetag(const unsigned char *p)
+{
+  double secs = static_cast<uint32_t>(osc_int(p));
+  double frac = static_cast<uint32_t>(osc_int(p + 4)) / 4294967296.;
+  return (secs + frac - OSC_NTP_UNIX_OFFSET) * 1000.;
+}
+
+static bool osc_frame(t_osc_receiver *r, const unsigned char *p)
+{
+  static const char header[] = "/bitalino\0\0\0,iiiiiiiiiii\0\0\0\0";
+
+  if (osc_int(p) != OSC_FRAMESIZE - 4) return false;
+  if (memcmp(p + 4, "#bundle\0", 8) != 0) return false;
+  if (osc_int(p + 20) != OSC_FRAMESIZE - 24) return false;
+  if (memcmp(p + 24, header, 28) != 0) return false;
+
+  double time = osc_timetag(p + 12);
+  int seq = osc_int(p + 52);
+
+  if (seq < 0 || seq > 15) return false;
+  for (int j = 0; j < 6; j++) {
+    int32_t a = osc_int(p + 56 + 4 * j);
+    if (a < 0 || a > 1023) return false;
+  }
+  for (int j = 0; j < 4; j++) {
+    int32_t d = osc_int(p + 80 + 4 * j);
+    if (d != 0 && d != 1) return false;
+  }
+
+  if (r->last_seq >= 0) {
+    r->gaps += (seq - r->last_seq - 1) & 0x0F;
+    if (time <= r->last_time) r->backwards++;
+  }
+  if (fabs(time - osc_system_ms()) > OSC_MAXCLOCKDIFF) r->late++;
+
+  r->last_seq = seq;
+  r->last_time = time;
+  r->frames++;
+  return true;
+}
+
+static void osc_datagram(t_osc_receiver *r, const unsigned char *p, long size)
+{
+  r->datagrams++;
+  if (size > r->max_size) r->max_size = size;
+
+  long nframes = (size - 16) / OSC_FRAMESIZE;
+
+  // outer bundle "immediately", holding one bundle per frame
+  if (size < 16 + OSC_FRAMESIZE || (size - 16) % OSC_FRAMESIZE != 0 ||
+      memcmp(p, "#bundle\0", 8) != 0 || osc_int(p + 8) != 0 ||
+      osc_int(p + 12) != 1 || nframes > 15) {
+    r->errors++;
+    return;
+  }
+
+  for (long i = 0; i < nframes; i++) {
+    if (!osc_frame(r, p + 16 + i * OSC_FRAMESIZE)) {
+      r->errors++;
+      return;
+    }
+  }
+  r->counts[nframes]++;
+}
+
+static void osc_receive(t_osc_receiver *r)
+{
+  unsigned char buffer[2048];
+  ssize_t size;
+
+  while ((size = recv(r->sock, buffer, sizeof(buffer), MSG_DONTWAIT)) >= 0) {
+    osc_datagram(r, buffer, size);
+  }
+}
+
+static bool osc_case(const t_osc_case *c)
+{
+  t_osc_receiver r;
+  memset(&r, 0, sizeof(r));
+  r.last_seq = -1;
+
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  r.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  int rcvbuf = 1 << 20;
+  setsockopt(r.sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  if (r.sock < 0 || bind(r.sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      getsockname(r.sock, (struct sockaddr *)&addr, &addrlen) < 0) {
+    printf("%-12s can't open the receiver socket   FAILED\n", c->name);
+    return false;
+  }
+
+  char args[128];
+  snprintf(args, sizeof(args), "@host 127.0.0.1 @port %d %s",
+           ntohs(addr.sin_port), c->args);
+
+  unsigned long frames0 = fake_bitalino::frames;
+  t_object *x = stub_new("bitalino", args);
+  stub_send(x, "connect v2 osc");
+
+  double end = stub_now() + OSC_RUN;
+  while (stub_now() < end) {
+    stub_run(OSC_STEP);
+    osc_receive(&r);
+  }
+
+  // the last incomplete bundle is sent when the socket is closed
+  stub_send(x, "disconnect");
+  unsigned long frames = fake_bitalino::frames - frames0;
+  stub_free(x);
+  usleep(10000);
+  osc_receive(&r);
+  close(r.sock);
+
+  // all datagrams hold the expected number of frames, but the last one
+  unsigned long expected = 0;
+  for (int i = 0; i < 2; i++) {
+    if (c->sizes[i] > 0) expected += r.counts[c->sizes[i]];
+  }
+  r.unexpected = r.datagrams - r.errors - expected;
+
+  bool ok = r.datagrams > 0 && r.errors == 0 && r.gaps == 0 &&
+            r.backwards == 0 && r.late == 0 && r.unexpected <= 1 &&
+            r.max_size <= OSC_MAXDATAGRAM && frames > 0 && r.frames == frames;
+
+  printf("%-12s %6lu frames read %6lu received %5lu datagrams (max %4ld "
+         "bytes)  errors %lu gaps %lu backwards %lu late %lu unexpected %lu%s\n",
+         c->name, frames, r.frames, r.datagrams, r.max_size, r.errors,
+         r.gaps, r.backwards, r.late, r.unexpected, ok ? "" : "   FAILED");
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  stub_verbose(getenv("BITALINO_TEST_VERBOSE") != NULL);
+  bitalino_main();
+
+  bool ok = true;
+  const long n = sizeof(osc_cases) / sizeof(osc_cases[0]);
+
+  for (long i = 0; i < n; i++) {
+    if (argc > 1 && strcmp(argv[1], osc_cases[i].name) != 0) continue;
+    ok = osc_case(osc_cases + i) && ok;
+  }
+
+  if (fake_bitalino::open_devices != 0) {
+    printf("%ld simulated boards still open\n",
+           fake_bitalino::open_devices.load());
+    ok = false;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,494 @@
+/**
+ *
+ * @file test_stress.cpp
+ *
+ * @brief many simulated boards with random traffic, for TSan and soak runs
+ *
+ * Each board gets random connect / disconnect / getstate / battery / pwm /
+ * trigger / stats / latency messages and attribute changes (modes, groups,
+ * OSC output), objects are sometimes freed and recreated, and outputs
+ * sometimes call back into the object. Simulated boards can lose frames or
+ * the connection. Throughput, CPU per board, drops and memory are reported
+ * periodically. Fails if the main thread stalls (deadlock), if a port is
+ * opened while another object uses it, if boards are left open, or if
+ * memory grows more than --max-growth.
+ *
+ */
+
+#include "ext.h"
+#include "max_stub.h"
+#include "bitalino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <atomic>
+
+#define STRESS_MAXBOARDS 32
+#define STRESS_STEP 5               // ms between traffic bursts
+#define STRESS_OP_PROBABILITY 0.02  // per board and step
+#define STRESS_STALL 10000          // ms without progress = deadlock
+#define STRESS_NGROUPS 3
+
+int bitalino_main(void);
+
+typedef struct _stress_board {
+  t_object            *x;
+  int                 index;
+  unsigned long       outputs;      // frames, group frames and summaries
+  unsigned long       last_outputs;
+  unsigned long       states;
+  long                lost;         // last /stats/drops
+  long                overflows;
+  long                read_errors;
+  double              cpu;          // last /stats/cpu
+  int                 depth;        // reentrant calls from the outlet
+} t_stress_board;
+
+typedef struct _stress_options {
+  int                 boards;
+  double              seconds;
+  double              report;
+  unsigned long long  seed;
+  double              speed;
+  double              failures;
+  double              loss;
+  long                max_growth;   // KB, 0 = no limit
+} t_stress_options;
+
+static t_stress_board boards[STRESS_MAXBOARDS];
+static unsigned long long stress_seed;
+
+static std::atomic<double> heartbeat(0);
+static std::atomic<bool> finished(false);
+
+//==================================== utilities =============================//
+
+static unsigned long long stress_rand(void)
+{
+  stress_seed ^= stress_seed << 13;
+  stress_seed ^= stress_seed >> 7;
+  stress_seed ^= stress_seed << 17;
+  return stress_seed;
+}
+
+static double stress_uniform(void)
+{
+  return (stress_rand() >> 11) * (1. / 9007199254740992.);
+}
+
+static long stress_rss_kb(void)
+{
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != NULL) {
+    long size;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) pages = 0;
+    fclose(f);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+  // no procfs (macOS) : peak instead of current
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss / 1024;
+}
+
+static double stress_cpu_ms(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000. +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 0.001;
+}
+
+// aborts when the main thread doesn't come back from the object
+static void *stress_watchdog(void *arg)
+{
+  while (!finished) {
+    usleep(100000);
+    if (stub_now() - heartbeat > STRESS_STALL) {
+      fprintf(stderr, "main thread stalled for %ds (deadlock ?)\n",
+              STRESS_STALL / 1000);
+      abort();
+    }
+  }
+  return NULL;
+}
+
+//==================================== boards ================================//
+
+static void stress_outlet(void *ctx, t_object *x, t_symbol *s,
+                          long ac, t_atom *av)
+{
+  t_stress_board *b = (t_stress_board *)ctx;
+  const char *name = s->s_name;
+
+  if (s == gensym("/A1") || s == gensym("/group") ||
+      s == gensym("/summary/A1")) {
+    b->outputs++;
+
+    // downstream objects calling back into the object
+    if (b->depth == 0 && stress_uniform() < 0.001) {
+      b->depth++;
+      stub_send(x, stress_uniform() < 0.5 ? "stats" : "latency");
+      b->depth--;
+    }
+  } else if (strcmp(name, "/state/battery") == 0) {
+    b->states++;
+  } else if (strcmp(name, "/stats/drops") == 0 && ac >= 3) {
+    b->lost = atom_getlong(av);
+    b->overflows = atom_getlong(av + 1);
+    b->read_errors = atom_getlong(av + 2);
+  } else if (strcmp(name, "/stats/cpu") == 0 && ac >= 1) {
+    b->cpu = atom_getfloat(av);
+  }
+}
+
+static void stress_new(t_stress_board *b)
+{
+  static const char *modes[] = {
+    "@continuous 1",
+    "@continuous 0",
+    "@summary 1",
+    "@onchange 1 @deadband 10 @keepalive 50",
+    "@probes 1",
+    "@group g0",
+    "@host 127.0.0.1 @port 9 @bundle 10"
+  };
+
+  b->x = stub_new("bitalino", modes[stress_rand() % 7]);
+  stub_outlet_hook(b->x, stress_outlet, b);
+}
+
+static void stress_op(t_stress_board *b)
+{
+  char message[64];
+  unsigned long r = stress_rand() % 100;
+
+  if (r < 8) {
+    // mostly each board its own port, sometimes v1 ports, or ports
+    // shared with other boards : default v2 and "unknown" (v2 or v1)
+    unsigned long kind = stress_rand() % 10;
+    if (kind < 2) {
+      stub_send(b->x, "connect");
+    } else if (kind < 4) {
+      stub_send(b->x, "connect v2");
+    } else if (kind == 4) {
+      snprintf(message, sizeof(message), "connect v1 %d", b->index);
+      stub_send(b->x, message);
+    } else {
+      snprintf(message, sizeof(message), "connect v2 s%02d", b->index);
+      stub_send(b->x, message);
+    }
+  } else if (r < 13) {
+    stub_send(b->x, "disconnect");
+  } else if (r < 25) {
+    stub_send(b->x, "getstate");
+  } else if (r < 37) {
+    snprintf(message, sizeof(message), "pwm %d", (int)(stress_rand() % 300));
+    stub_send(b->x, message);
+  } else if (r < 49) {
+    snprintf(message, sizeof(message), "trigger %d %d %d %d",
+             (int)(stress_rand() & 1), (int)(stress_rand() & 1),
+             (int)(stress_rand() & 1), (int)(stress_rand() & 1));
+    stub_send(b->x, message);
+  } else if (r < 55) {
+    snprintf(message, sizeof(message), "battery %d", (int)(stress_rand() % 70));
+    stub_send(b->x, message);
+  } else if (r < 61) {
+    stub_send(b->x, "stats");
+  } else if (r < 64) {
+    stub_send(b->x, stress_rand() & 1 ? "latency" : "latency reset");
+  } else if (r < 67) {
+    stub_send(b->x, stress_rand() & 1 ? "continuous 1" : "continuous 0");
+  } else if (r < 70) {
+    stub_send(b->x, stress_rand() & 1 ? "summary 1" : "summary 0");
+  } else if (r < 73) {
+    stub_send(b->x, stress_rand() & 1 ? "probes 1" : "probes 0");
+  } else if (r < 75) {
+    stub_send(b->x, stress_rand() % 4 ? "automatic 1" : "automatic 0");
+  } else if (r < 78) {
+    stub_send(b->x, stress_rand() & 1 ? "onchange 1" : "onchange 0");
+  } else if (r < 80) {
+    snprintf(message, sizeof(message), "deadband %d",
+             (int)(stress_rand() % 50));
+    stub_send(b->x, message);
+  } else if (r < 85) {
+    unsigned long g = stress_rand() % (STRESS_NGROUPS + 1);
+    if (g == STRESS_NGROUPS) {
+      stub_send(b->x, "group \"\"");
+    } else {
+      snprintf(message, sizeof(message), "group g%lu", g);
+      stub_send(b->x, message);
+    }
+  } else if (r < 88) {
+    stub_send(b->x, stress_rand() & 1 ? "port 0" : "port 9");
+  } else if (r < 90) {
+    stub_send(b->x, stress_rand() & 1 ? "host 127.0.0.1" : "host localhost");
+  } else if (r < 93) {
+    snprintf(message, sizeof(message), "bundle %d",
+             (int)(stress_rand() % 80));
+    stub_send(b->x, message);
+  } else if (r < 95) {
+    snprintf(message, sizeof(message), "sendinterval %d",
+             (int)(stress_rand() % 30));
+    stub_send(b->x, message);
+  } else if (r < 96) {
+    stub_send(b->x, "stats reset");
+  } else if (r < 97) {
+    // the object is deleted, as when its patcher is closed, then recreated
+    stub_free(b->x);
+    stress_new(b);
+    snprintf(message, sizeof(message), "connect v2 s%02d", b->index);
+    stub_send(b->x, message);
+  }
+  // else nothing this time
+}
+
+// an anonymous connect must not probe the default port of a streaming board
+static bool stress_ports(void)
+{
+  t_object *a = stub_new("bitalino", "");
+  t_object *b = stub_new("bitalino", "");
+  unsigned long shared = fake_bitalino::shared_opens;
+
+  stub_send(a, "connect v2");
+  stub_run(200);
+  stub_send(b, "connect");
+  stub_run(200);
+
+  bool ok = fake_bitalino::shared_opens == shared;
+  printf("anonymous connect next to a streaming board : %s\n",
+         ok ? "ok" : "port opened twice");
+
+  stub_send(a, "disconnect");
+  stub_send(b, "disconnect");
+  stub_free(a);
+  stub_free(b);
+  return ok;
+}
+
+//==================================== report ================================//
+
+typedef struct _stress_sample {
+  double              time;
+  double              cpu;
+  unsigned long       frames;
+  unsigned long       outputs;
+  double              thread_cpu;   // sum of the reported thread cpu
+  long                reports;
+} t_stress_sample;
+
+static void stress_sample(t_stress_sample *s, int n)
+{
+  s->time = stub_now();
+  s->cpu = stress_cpu_ms();
+  s->frames = fake_bitalino::frames;
+  s->outputs = 0;
+  s->thread_cpu = 0;
+  s->reports = 0;
+  for (int i = 0; i < n; i++) {
+    s->outputs += boards[i].outputs;
+  }
+}
+
+// `total` reports the whole run : the boards are not asked for their stats
+// again, and the thread cpu is the mean of the periodic reports
+static void stress_report(const t_stress_sample *from, t_stress_sample *to,
+                          int n, long rss, long rss0, bool total)
+{
+  double elapsed = (to->time - from->time) * 0.001;
+  long lost = 0;
+  long overflows = 0;
+  long read_errors = 0;
+  double thread_cpu = 0;
+  int streaming = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (!total) {
+      stub_send(boards[i].x, "stats");
+    }
+    lost += boards[i].lost;
+    overflows += boards[i].overflows;
+    read_errors += boards[i].read_errors;
+    thread_cpu += boards[i].cpu;
+    if (total ? boards[i].outputs > 0 :
+                boards[i].outputs > boards[i].last_outputs) {
+      streaming++;
+    }
+    boards[i].last_outputs = boards[i].outputs;
+  }
+
+  if (total) {
+    thread_cpu = to->reports > 0 ? to->thread_cpu / to->reports : 0;
+  } else {
+    to->thread_cpu = from->thread_cpu + thread_cpu;
+    to->reports = from->reports + 1;
+  }
+
+  printf("%7.1fs %2d/%2d streaming  read %7.0f frames/s  out %7.0f msg/s  "
+         "cpu %5.2f%%/board (thread %5.2f%%)  "
+         "lost %ld overflows %ld errors %ld  rss %ld KB (%+ld)\n",
+         to->time * 0.001, streaming, n,
+         elapsed > 0 ? (to->frames - from->frames) / elapsed : 0,
+         elapsed > 0 ? (to->outputs - from->outputs) / elapsed : 0,
+         elapsed > 0 ? (to->cpu - from->cpu) * 0.1 / elapsed / n : 0,
+         thread_cpu / n, lost, overflows, read_errors, rss, rss - rss0);
+  fflush(stdout);
+}
+
+//===================================== main =================================//
+
+static void stress_usage(void)
+{
+  fprintf(stderr,
+          "usage : test_stress [--boards 1-%d] [--seconds s] [--report s]\n"
+          "                    [--seed n] [--speed x] [--failures p]\n"
+          "                    [--loss p] [--max-growth KB]\n",
+          STRESS_MAXBOARDS);
+  exit(2);
+}
+
+static void stress_options(int argc, char **argv, t_stress_options *o)
+{
+  o->boards = 8;
+  o->seconds = 10;
+  o->report = 1;
+  o->seed = 1;
+  o->speed = 1;
+  o->failures = 0.001;
+  o->loss = 0.0001;
+  o->max_growth = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 == argc) stress_usage();
+    const char *value = argv[++i];
+
+    if (strcmp(argv[i - 1], "--boards") == 0) {
+      o->boards = atoi(value);
+    } else if (strcmp(argv[i - 1], "--seconds") == 0) {
+      o->seconds = atof(value);
+    } else if (strcmp(argv[i - 1], "--report") == 0) {
+      o->report = atof(value);
+    } else if (strcmp(argv[i - 1], "--seed") == 0) {
+      o->seed = strtoull(value, NULL, 10);
+    } else if (strcmp(argv[i - 1], "--speed") == 0) {
+      o->speed = atof(value);
+    } else if (strcmp(argv[i - 1], "--failures") == 0) {
+      o->failures = atof(value);
+    } else if (strcmp(argv[i - 1], "--loss") == 0) {
+      o->loss = atof(value);
+    } else if (strcmp(argv[i - 1], "--max-growth") == 0) {
+      o->max_growth = atol(value);
+    } else {
+      stress_usage();
+    }
+  }
+
+  if (o->boards < 1 || o->boards > STRESS_MAXBOARDS || o->seconds <= 0 ||
+      o->report <= 0 || o->speed <= 0) {
+    stress_usage();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  t_stress_options o;
+  stress_options(argc, argv, &o);
+
+  stress_seed = o.seed ? o.seed : 1;
+  fake_bitalino::speed = o.speed;
+  fake_bitalino::read_failure = o.failures;
+  fake_bitalino::frame_loss = o.loss;
+
+  stub_verbose(getenv("BITALINO_TEST_VERBOSE") != NULL);
+  bitalino_main();
+
+  bool ok = stress_ports();
+
+  printf("%d boards, %.0fs, seed %llu\n", o.boards, o.seconds, o.seed);
+
+  for (int i = 0; i < o.boards; i++) {
+    char message[64];
+    boards[i].index = i;
+    stress_new(boards + i);
+    snprintf(message, sizeof(message), "connect v2 s%02d", i);
+    stub_send(boards[i].x, message);
+  }
+
+  pthread_t watchdog;
+  heartbeat = stub_now();
+  pthread_create(&watchdog, NULL, stress_watchdog, NULL);
+
+  t_stress_sample first;
+  t_stress_sample last;
+  stress_sample(&first, o.boards);
+  last = first;
+
+  double start = stub_now();
+  double next_report = start + o.report * 1000;
+  long rss0 = -1;
+  long rss = 0;
+
+  while (stub_now() - start < o.seconds * 1000) {
+    stub_run(STRESS_STEP);
+    heartbeat = stub_now();
+
+    for (int i = 0; i < o.boards; i++) {
+      if (stress_uniform() < STRESS_OP_PROBABILITY) {
+        stress_op(boards + i);
+      }
+    }
+
+    if (stub_now() >= next_report) {
+      t_stress_sample now;
+      stress_sample(&now, o.boards);
+      rss = stress_rss_kb();
+      // memory after the first period is the reference
+      if (rss0 < 0) rss0 = rss;
+      stress_report(&last, &now, o.boards, rss, rss0, false);
+      last = now;
+      next_report += o.report * 1000;
+    }
+  }
+
+  t_stress_sample end;
+  stress_sample(&end, o.boards);
+  end.thread_cpu = last.thread_cpu;
+  end.reports = last.reports;
+  if (rss0 < 0) rss0 = rss = stress_rss_kb();
+
+  printf("total  :");
+  stress_report(&first, &end, o.boards, rss, rss0, true);
+
+  for (int i = 0; i < o.boards; i++) {
+    stub_send(boards[i].x, "disconnect");
+    stub_free(boards[i].x);
+    heartbeat = stub_now();
+  }
+
+  finished = true;
+  pthread_join(watchdog, NULL);
+
+  if (fake_bitalino::open_devices != 0) {
+    printf("%ld simulated boards still open\n",
+           fake_bitalino::open_devices.load());
+    ok = false;
+  }
+  if (fake_bitalino::shared_opens != 0) {
+    printf("%lu ports opened while in use\n",
+           fake_bitalino::shared_opens.load());
+    ok = false;
+  }
+  if (o.max_growth > 0 && rss - rss0 > o.max_growth) {
+    printf("memory grew by %ld KB (more than %ld KB)\n",
+           rss - rss0, o.max_growth);
+    ok = false;
+  }
+
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}